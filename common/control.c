@@ -0,0 +1,30 @@
+#include "control.h"
+
+#include "tools.h"
+
+// Phase increment per tick for 0.1Hz
+#define LFO_BASE_INCREMENT ((uint32_t)(0.1 * 4294967296.0 / CONTROL_RATE))
+
+void lfo_init(Lfo *lfo) {
+    lfo->phase = 0;
+    lfo->depth = 0;
+    lfo_set_rate(lfo, 80);
+}
+
+void lfo_set_rate(Lfo *lfo, uint8_t value) {
+    // 0.1Hz * 2^(value / 16)
+    uint32_t scale = fixed_exp2((value & 0x7F) << 12);
+    lfo->increment = ((uint64_t)LFO_BASE_INCREMENT * scale) >> 16;
+}
+
+int32_t lfo_tick(Lfo *lfo) {
+    int32_t y;
+
+    lfo->phase += lfo->increment;
+
+    y = (int32_t)(lfo->phase >> 16) - 32768;
+    y = 2 * (y < 0 ? -y : y) - 32768;
+    if(y > 32767) { y = 32767; }
+
+    return y * lfo->depth / 127;
+}
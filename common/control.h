@@ -0,0 +1,43 @@
+#pragma once
+
+// Control rate scheduling. Modulation sources (knob, envelopes, LFOs) are
+// evaluated once every CONTROL_PERIOD audio frames, the audio path only
+// ramps linearly between the values they publish.
+
+#include <stdint.h>
+
+#define CONTROL_SAMPLE_RATE 50000
+
+// Audio frames per control tick, 32 frames is ~1.5kHz, 25 is 2kHz and 50 is 1kHz
+#ifndef CONTROL_PERIOD
+#define CONTROL_PERIOD 32
+#endif
+
+#define CONTROL_RATE (CONTROL_SAMPLE_RATE / CONTROL_PERIOD)
+
+// MIDI CC numbers for the LFO
+#define LFO_CC_DEPTH 1
+#define LFO_CC_RATE 76
+
+typedef struct Lfo {
+    uint32_t phase;
+    uint32_t increment;
+    // 0..127, how far the output swings
+    uint8_t depth;
+} Lfo;
+
+void lfo_init(Lfo *lfo);
+
+// 0.1Hz (0) to about 24Hz (127)
+void lfo_set_rate(Lfo *lfo, uint8_t value);
+
+// Advance one control tick, returns a triangle scaled by depth, Q15
+int32_t lfo_tick(Lfo *lfo);
+
+// One-pole smoothing towards target, the time constant is 2^shift control ticks
+static inline int32_t control_smooth(int32_t value, int32_t target, uint8_t shift) {
+    int32_t delta = (target - value) >> shift;
+    // Make sure small differences still converge
+    if(delta == 0 && target != value) { delta = target > value ? 1 : -1; }
+    return value + delta;
+}
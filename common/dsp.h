@@ -0,0 +1,75 @@
+#pragma once
+
+// DSP kernels for the synth core. On a Cortex-M4 (__ARM_FEATURE_DSP) they
+// map to the DSP extension instructions, the F103 and host builds use
+// the C versions, which give bit identical results. The C versions are
+// always there as dsp_*_c so the two can be compared on the M4.
+//
+// Define DSP_REFERENCE to force the C versions on the M4 as well.
+
+#include <stdint.h>
+
+#if defined(__ARM_FEATURE_DSP) && !defined(DSP_REFERENCE)
+#define DSP_USE_M4 1
+#else
+#define DSP_USE_M4 0
+#endif
+
+// Saturate to the int16 range (SSAT #16)
+static inline int32_t dsp_ssat16_c(int32_t x) {
+    if(x > 32767) { return 32767; }
+    if(x < -32768) { return -32768; }
+    return x;
+}
+
+static inline int32_t dsp_ssat16(int32_t x) {
+#if DSP_USE_M4
+    int32_t r;
+    __asm__("ssat %0, #16, %1" : "=r"(r) : "r"(x));
+    return r;
+#else
+    return dsp_ssat16_c(x);
+#endif
+}
+
+// (a * b) >> 16 with b the bottom half of a 32-bit word (SMULWB)
+static inline int32_t dsp_smulwb_c(int32_t a, int32_t b) { return (int32_t)(((int64_t)a * (int16_t)b) >> 16); }
+
+static inline int32_t dsp_smulwb(int32_t a, int32_t b) {
+#if DSP_USE_M4
+    int32_t r;
+    __asm__("smulwb %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+    return r;
+#else
+    return dsp_smulwb_c(a, b);
+#endif
+}
+
+// acc + x.lo * y.lo + x.hi * y.hi on packed int16 pairs (SMLAD)
+static inline int32_t dsp_smlad_c(uint32_t x, uint32_t y, int32_t acc) {
+    return (int32_t)((uint32_t)acc + (uint32_t)((int16_t)x * (int16_t)y) +
+                     (uint32_t)((int16_t)(x >> 16) * (int16_t)(y >> 16)));
+}
+
+static inline int32_t dsp_smlad(uint32_t x, uint32_t y, int32_t acc) {
+#if DSP_USE_M4
+    int32_t r;
+    __asm__("smlad %0, %1, %2, %3" : "=r"(r) : "r"(x), "r"(y), "r"(acc));
+    return r;
+#else
+    return dsp_smlad_c(x, y, acc);
+#endif
+}
+
+// Pack two int16 values into one word, lo in the bottom half (PKHBT)
+static inline uint32_t dsp_pack16_c(int32_t lo, int32_t hi) { return (uint16_t)lo | ((uint32_t)hi << 16); }
+
+static inline uint32_t dsp_pack16(int32_t lo, int32_t hi) {
+#if DSP_USE_M4
+    uint32_t r;
+    __asm__("pkhbt %0, %1, %2, lsl #16" : "=r"(r) : "r"(lo), "r"(hi));
+    return r;
+#else
+    return dsp_pack16_c(lo, hi);
+#endif
+}
@@ -0,0 +1,85 @@
+#include "envelope.h"
+
+#include "control.h"
+
+// Segments aim past their end point so they finish in finite time
+#define ENV_ATTACK_TARGET (ENV_ONE + ENV_ONE / 4)
+#define ENV_RELEASE_TARGET (-ENV_ONE / 16)
+// Decay is done once it gets this close to the sustain level
+#define ENV_DECAY_EPSILON (ENV_ONE >> 12)
+
+// 65536 * (1 - exp(-0.64ms / tau)), tau = 2^(value / 11) ms, for a tick of 32 frames at 50kHz
+static const uint16_t env_coefficients[128] = {
+    30979, 29602, 28259, 26952, 25683, 24454, 23266, 22118, 21013, 19949, 18927, 17947,
+    17008, 16109, 15250, 14430, 13648, 12903, 12194, 11519, 10877, 10268, 9690, 9142,
+    8622, 8129, 7663, 7222, 6805, 6410, 6037, 5685, 5353, 5039, 4742, 4463,
+    4199, 3951, 3716, 3496, 3288, 3092, 2907, 2733, 2570, 2416, 2271, 2134,
+    2006, 1885, 1772, 1665, 1564, 1470, 1381, 1298, 1219, 1145, 1076, 1011,
+    950, 892, 838, 787, 739, 694, 652, 612, 575, 540, 507, 477,
+    448, 420, 395, 371, 348, 327, 307, 288, 271, 254, 239, 224,
+    210, 198, 186, 174, 164, 154, 144, 135, 127, 119, 112, 105,
+    99, 93, 87, 82, 77, 72, 68, 64, 60, 56, 53, 49,
+    46, 44, 41, 38, 36, 34, 32, 30, 28, 26, 25, 23,
+    22, 20, 19, 18, 17, 16, 15, 14
+};
+
+// Other control periods scale the coefficients, which is close enough for the slow segments
+static uint16_t env_coefficient(uint8_t value) {
+    uint32_t coefficient = (uint32_t)env_coefficients[value & 0x7F] * CONTROL_PERIOD / 32;
+    return coefficient > 65535 ? 65535 : coefficient;
+}
+
+void envelope_init(Envelope *env) {
+    envelope_set_attack(env, 0);
+    envelope_set_decay(env, 99);
+    envelope_set_sustain(env, 0);
+    envelope_set_release(env, 70);
+}
+
+void envelope_set_attack(Envelope *env, uint8_t value) { env->attack = env_coefficient(value); }
+
+void envelope_set_decay(Envelope *env, uint8_t value) { env->decay = env_coefficient(value); }
+
+void envelope_set_release(Envelope *env, uint8_t value) { env->release = env_coefficient(value); }
+
+void envelope_set_sustain(Envelope *env, uint8_t value) { env->sustain = (value & 0x7F) * (ENV_ONE / 127); }
+
+static inline int32_t envelope_approach(int32_t level, int32_t target, uint16_t coefficient) {
+    return level + (int32_t)(((int64_t)(target - level) * coefficient) >> 16);
+}
+
+int32_t envelope_tick(const Envelope *env, uint8_t *stage, int32_t level) {
+    switch(*stage) {
+        case ENV_ATTACK:
+            level = envelope_approach(level, ENV_ATTACK_TARGET, env->attack);
+            if(level >= ENV_ONE) {
+                level = ENV_ONE;
+                *stage = ENV_DECAY;
+            }
+            break;
+
+        case ENV_DECAY:
+            level = envelope_approach(level, env->sustain, env->decay);
+            if(level - env->sustain < ENV_DECAY_EPSILON) { *stage = ENV_SUSTAIN; }
+            break;
+
+        case ENV_SUSTAIN:
+            // Follows sustain level changes
+            level = envelope_approach(level, env->sustain, env->decay);
+            break;
+
+        case ENV_RELEASE:
+            level = envelope_approach(level, ENV_RELEASE_TARGET, env->release);
+            if(level <= 0) {
+                level = 0;
+                *stage = ENV_IDLE;
+            }
+            break;
+
+        default:
+            level = 0;
+            break;
+    }
+
+    return level;
+}
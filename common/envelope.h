@@ -0,0 +1,44 @@
+#pragma once
+
+// Fixed point ADSR envelope with exponential segments. It is ticked at
+// control rate (see control.h), the renderer ramps linearly between ticks.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Level is Q30, 1 << 30 is full scale
+#define ENV_ONE (1 << 30)
+
+enum {
+    ENV_IDLE = 0,
+    ENV_ATTACK,
+    ENV_DECAY,
+    ENV_SUSTAIN,
+    ENV_RELEASE,
+};
+
+// MIDI CC numbers for the envelope (sound controllers)
+#define ENV_CC_RELEASE 72
+#define ENV_CC_ATTACK 73
+#define ENV_CC_DECAY 75
+#define ENV_CC_SUSTAIN 79
+
+typedef struct Envelope {
+    // Per tick one-pole coefficients, Q16
+    uint16_t attack;
+    uint16_t decay;
+    uint16_t release;
+    // Q30
+    int32_t sustain;
+} Envelope;
+
+void envelope_init(Envelope *env);
+
+// Time constants go from 1ms (0) to about 3s (127)
+void envelope_set_attack(Envelope *env, uint8_t value);
+void envelope_set_decay(Envelope *env, uint8_t value);
+void envelope_set_release(Envelope *env, uint8_t value);
+void envelope_set_sustain(Envelope *env, uint8_t value);
+
+// Advance one control tick, returns the new level and updates the stage
+int32_t envelope_tick(const Envelope *env, uint8_t *stage, int32_t level);
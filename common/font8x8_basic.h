@@ -18,104 +18,118 @@
  * Fetched from: http://dimensionalrift.homelinux.net/combuster/mos3/?p=viewsource&file=/modules/gfx/font8_8.asm
  **/
 
+#include <stdint.h>
+
+// Glyphs are written as 8 rows, bit 0 the leftmost pixel. The compiler
+// transposes them into 8 column bytes, bit 0 the top pixel, which is the
+// SSD1306 page layout: drawing a glyph is one OR per column.
+#define FONT8X8_BIT(r, row, c) ((((r) >> (c)) & 1) << (row))
+#define FONT8X8_COL(c, r0, r1, r2, r3, r4, r5, r6, r7)                                                        \
+    (uint8_t)(FONT8X8_BIT(r0, 0, c) | FONT8X8_BIT(r1, 1, c) | FONT8X8_BIT(r2, 2, c) | FONT8X8_BIT(r3, 3, c) | \
+              FONT8X8_BIT(r4, 4, c) | FONT8X8_BIT(r5, 5, c) | FONT8X8_BIT(r6, 6, c) | FONT8X8_BIT(r7, 7, c))
+#define FONT8X8_GLYPH(...)                                                                  \
+    {FONT8X8_COL(0, __VA_ARGS__), FONT8X8_COL(1, __VA_ARGS__), FONT8X8_COL(2, __VA_ARGS__), \
+     FONT8X8_COL(3, __VA_ARGS__), FONT8X8_COL(4, __VA_ARGS__), FONT8X8_COL(5, __VA_ARGS__), \
+     FONT8X8_COL(6, __VA_ARGS__), FONT8X8_COL(7, __VA_ARGS__)}
+
 // Constant: font8x8_basic
 // Contains an 8x8 font map for unicode points U+0000 - U+007F (basic latin)
-// Start from index 32
-char font8x8_basic[96][8] = {
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0020 (space)
-    { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00},   // U+0021 (!)
-    { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0022 (")
-    { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00},   // U+0023 (#)
-    { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00},   // U+0024 ($)
-    { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00},   // U+0025 (%)
-    { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00},   // U+0026 (&)
-    { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0027 (')
-    { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00},   // U+0028 (()
-    { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00},   // U+0029 ())
-    { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00},   // U+002A (*)
-    { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00},   // U+002B (+)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06},   // U+002C (,)
-    { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00},   // U+002D (-)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00},   // U+002E (.)
-    { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00},   // U+002F (/)
-    { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00},   // U+0030 (0)
-    { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00},   // U+0031 (1)
-    { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00},   // U+0032 (2)
-    { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00},   // U+0033 (3)
-    { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00},   // U+0034 (4)
-    { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00},   // U+0035 (5)
-    { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00},   // U+0036 (6)
-    { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00},   // U+0037 (7)
-    { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00},   // U+0038 (8)
-    { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00},   // U+0039 (9)
-    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00},   // U+003A (:)
-    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06},   // U+003B (;)
-    { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00},   // U+003C (<)
-    { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00},   // U+003D (=)
-    { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00},   // U+003E (>)
-    { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00},   // U+003F (?)
-    { 0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00},   // U+0040 (@)
-    { 0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00},   // U+0041 (A)
-    { 0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00},   // U+0042 (B)
-    { 0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00},   // U+0043 (C)
-    { 0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00},   // U+0044 (D)
-    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00},   // U+0045 (E)
-    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00},   // U+0046 (F)
-    { 0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00},   // U+0047 (G)
-    { 0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00},   // U+0048 (H)
-    { 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},   // U+0049 (I)
-    { 0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00},   // U+004A (J)
-    { 0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00},   // U+004B (K)
-    { 0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00},   // U+004C (L)
-    { 0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00},   // U+004D (M)
-    { 0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00},   // U+004E (N)
-    { 0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00},   // U+004F (O)
-    { 0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00},   // U+0050 (P)
-    { 0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00},   // U+0051 (Q)
-    { 0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00},   // U+0052 (R)
-    { 0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00},   // U+0053 (S)
-    { 0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},   // U+0054 (T)
-    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00},   // U+0055 (U)
-    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00},   // U+0056 (V)
-    { 0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00},   // U+0057 (W)
-    { 0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00},   // U+0058 (X)
-    { 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00},   // U+0059 (Y)
-    { 0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00},   // U+005A (Z)
-    { 0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00},   // U+005B ([)
-    { 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00},   // U+005C (\)
-    { 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00},   // U+005D (])
-    { 0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00},   // U+005E (^)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},   // U+005F (_)
-    { 0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0060 (`)
-    { 0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00},   // U+0061 (a)
-    { 0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00},   // U+0062 (b)
-    { 0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00},   // U+0063 (c)
-    { 0x38, 0x30, 0x30, 0x3e, 0x33, 0x33, 0x6E, 0x00},   // U+0064 (d)
-    { 0x00, 0x00, 0x1E, 0x33, 0x3f, 0x03, 0x1E, 0x00},   // U+0065 (e)
-    { 0x1C, 0x36, 0x06, 0x0f, 0x06, 0x06, 0x0F, 0x00},   // U+0066 (f)
-    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F},   // U+0067 (g)
-    { 0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00},   // U+0068 (h)
-    { 0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},   // U+0069 (i)
-    { 0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E},   // U+006A (j)
-    { 0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00},   // U+006B (k)
-    { 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},   // U+006C (l)
-    { 0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00},   // U+006D (m)
-    { 0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00},   // U+006E (n)
-    { 0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00},   // U+006F (o)
-    { 0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F},   // U+0070 (p)
-    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78},   // U+0071 (q)
-    { 0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00},   // U+0072 (r)
-    { 0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00},   // U+0073 (s)
-    { 0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00},   // U+0074 (t)
-    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00},   // U+0075 (u)
-    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00},   // U+0076 (v)
-    { 0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00},   // U+0077 (w)
-    { 0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00},   // U+0078 (x)
-    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F},   // U+0079 (y)
-    { 0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00},   // U+007A (z)
-    { 0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00},   // U+007B ({)
-    { 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00},   // U+007C (|)
-    { 0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00},   // U+007D (})
-    { 0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+007E (~)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}    // U+007F
+// Start from index 32, column-major
+static const uint8_t font8x8_basic[96][8] = {
+    FONT8X8_GLYPH(0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00),   // U+0020 (space)
+    FONT8X8_GLYPH(0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00),   // U+0021 (!)
+    FONT8X8_GLYPH(0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00),   // U+0022 (")
+    FONT8X8_GLYPH(0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00),   // U+0023 (#)
+    FONT8X8_GLYPH(0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00),   // U+0024 ($)
+    FONT8X8_GLYPH(0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00),   // U+0025 (%)
+    FONT8X8_GLYPH(0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00),   // U+0026 (&)
+    FONT8X8_GLYPH(0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00),   // U+0027 (')
+    FONT8X8_GLYPH(0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00),   // U+0028 (()
+    FONT8X8_GLYPH(0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00),   // U+0029 ())
+    FONT8X8_GLYPH(0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00),   // U+002A (*)
+    FONT8X8_GLYPH(0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00),   // U+002B (+)
+    FONT8X8_GLYPH(0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06),   // U+002C (,)
+    FONT8X8_GLYPH(0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00),   // U+002D (-)
+    FONT8X8_GLYPH(0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00),   // U+002E (.)
+    FONT8X8_GLYPH(0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00),   // U+002F (/)
+    FONT8X8_GLYPH(0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00),   // U+0030 (0)
+    FONT8X8_GLYPH(0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00),   // U+0031 (1)
+    FONT8X8_GLYPH(0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00),   // U+0032 (2)
+    FONT8X8_GLYPH(0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00),   // U+0033 (3)
+    FONT8X8_GLYPH(0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00),   // U+0034 (4)
+    FONT8X8_GLYPH(0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00),   // U+0035 (5)
+    FONT8X8_GLYPH(0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00),   // U+0036 (6)
+    FONT8X8_GLYPH(0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00),   // U+0037 (7)
+    FONT8X8_GLYPH(0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00),   // U+0038 (8)
+    FONT8X8_GLYPH(0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00),   // U+0039 (9)
+    FONT8X8_GLYPH(0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00),   // U+003A (:)
+    FONT8X8_GLYPH(0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06),   // U+003B (;)
+    FONT8X8_GLYPH(0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00),   // U+003C (<)
+    FONT8X8_GLYPH(0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00),   // U+003D (=)
+    FONT8X8_GLYPH(0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00),   // U+003E (>)
+    FONT8X8_GLYPH(0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00),   // U+003F (?)
+    FONT8X8_GLYPH(0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00),   // U+0040 (@)
+    FONT8X8_GLYPH(0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00),   // U+0041 (A)
+    FONT8X8_GLYPH(0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00),   // U+0042 (B)
+    FONT8X8_GLYPH(0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00),   // U+0043 (C)
+    FONT8X8_GLYPH(0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00),   // U+0044 (D)
+    FONT8X8_GLYPH(0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00),   // U+0045 (E)
+    FONT8X8_GLYPH(0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00),   // U+0046 (F)
+    FONT8X8_GLYPH(0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00),   // U+0047 (G)
+    FONT8X8_GLYPH(0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00),   // U+0048 (H)
+    FONT8X8_GLYPH(0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00),   // U+0049 (I)
+    FONT8X8_GLYPH(0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00),   // U+004A (J)
+    FONT8X8_GLYPH(0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00),   // U+004B (K)
+    FONT8X8_GLYPH(0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00),   // U+004C (L)
+    FONT8X8_GLYPH(0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00),   // U+004D (M)
+    FONT8X8_GLYPH(0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00),   // U+004E (N)
+    FONT8X8_GLYPH(0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00),   // U+004F (O)
+    FONT8X8_GLYPH(0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00),   // U+0050 (P)
+    FONT8X8_GLYPH(0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00),   // U+0051 (Q)
+    FONT8X8_GLYPH(0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00),   // U+0052 (R)
+    FONT8X8_GLYPH(0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00),   // U+0053 (S)
+    FONT8X8_GLYPH(0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00),   // U+0054 (T)
+    FONT8X8_GLYPH(0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00),   // U+0055 (U)
+    FONT8X8_GLYPH(0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00),   // U+0056 (V)
+    FONT8X8_GLYPH(0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00),   // U+0057 (W)
+    FONT8X8_GLYPH(0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00),   // U+0058 (X)
+    FONT8X8_GLYPH(0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00),   // U+0059 (Y)
+    FONT8X8_GLYPH(0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00),   // U+005A (Z)
+    FONT8X8_GLYPH(0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00),   // U+005B ([)
+    FONT8X8_GLYPH(0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00),   // U+005C (\)
+    FONT8X8_GLYPH(0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00),   // U+005D (])
+    FONT8X8_GLYPH(0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00),   // U+005E (^)
+    FONT8X8_GLYPH(0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF),   // U+005F (_)
+    FONT8X8_GLYPH(0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00),   // U+0060 (`)
+    FONT8X8_GLYPH(0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00),   // U+0061 (a)
+    FONT8X8_GLYPH(0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00),   // U+0062 (b)
+    FONT8X8_GLYPH(0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00),   // U+0063 (c)
+    FONT8X8_GLYPH(0x38, 0x30, 0x30, 0x3e, 0x33, 0x33, 0x6E, 0x00),   // U+0064 (d)
+    FONT8X8_GLYPH(0x00, 0x00, 0x1E, 0x33, 0x3f, 0x03, 0x1E, 0x00),   // U+0065 (e)
+    FONT8X8_GLYPH(0x1C, 0x36, 0x06, 0x0f, 0x06, 0x06, 0x0F, 0x00),   // U+0066 (f)
+    FONT8X8_GLYPH(0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F),   // U+0067 (g)
+    FONT8X8_GLYPH(0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00),   // U+0068 (h)
+    FONT8X8_GLYPH(0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00),   // U+0069 (i)
+    FONT8X8_GLYPH(0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E),   // U+006A (j)
+    FONT8X8_GLYPH(0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00),   // U+006B (k)
+    FONT8X8_GLYPH(0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00),   // U+006C (l)
+    FONT8X8_GLYPH(0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00),   // U+006D (m)
+    FONT8X8_GLYPH(0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00),   // U+006E (n)
+    FONT8X8_GLYPH(0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00),   // U+006F (o)
+    FONT8X8_GLYPH(0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F),   // U+0070 (p)
+    FONT8X8_GLYPH(0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78),   // U+0071 (q)
+    FONT8X8_GLYPH(0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00),   // U+0072 (r)
+    FONT8X8_GLYPH(0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00),   // U+0073 (s)
+    FONT8X8_GLYPH(0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00),   // U+0074 (t)
+    FONT8X8_GLYPH(0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00),   // U+0075 (u)
+    FONT8X8_GLYPH(0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00),   // U+0076 (v)
+    FONT8X8_GLYPH(0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00),   // U+0077 (w)
+    FONT8X8_GLYPH(0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00),   // U+0078 (x)
+    FONT8X8_GLYPH(0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F),   // U+0079 (y)
+    FONT8X8_GLYPH(0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00),   // U+007A (z)
+    FONT8X8_GLYPH(0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00),   // U+007B ({)
+    FONT8X8_GLYPH(0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00),   // U+007C (|)
+    FONT8X8_GLYPH(0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00),   // U+007D (})
+    FONT8X8_GLYPH(0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00),   // U+007E (~)
+    FONT8X8_GLYPH(0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00)    // U+007F
 };
@@ -1,16 +1,27 @@
 #include "i2s_spi.h"
-#include "udelay.h"
 
-#define WS_PIN GPIO3
+// TIM2 runs one update per word, two words per frame
+#define I2S_WORD_TICKS 10
+
+// Ping-pong buffer, DMA sends one half while the other gets rendered
+static uint16_t audio_buffer[I2S_BLOCK_FRAMES * 2 * 2] __attribute__((aligned(4)));
+
+static i2s_fill_cb fill_callback;
+
+// Completed trips around the buffer
+static volatile uint32_t buffer_wraps = 0;
+
+volatile uint32_t i2s_isr_cycles = 0;
+volatile uint32_t i2s_isr_cycles_max = 0;
 
 void i2s_spi_setup(void) {
     rcc_periph_clock_enable(RCC_GPIOA);
     rcc_periph_clock_enable(RCC_SPI1);
-    rcc_periph_clock_enable(RCC_TIM3);
+    rcc_periph_clock_enable(RCC_TIM2);
+    rcc_periph_clock_enable(RCC_DMA1);
 
-    // Configure Word Select (WS) pin as output
-    rcc_periph_clock_enable(RCC_GPIOA);
-    gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL, WS_PIN);
+    // Word Select (WS) pin is driven by TIM2_CH4
+    gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, WS_PIN);
 
     /* Configure GPIOs: SS=PA4, SCK=PA5, MISO=PA6 and MOSI=PA7 */
     gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO4 | GPIO5 | GPIO7);
@@ -43,32 +54,93 @@ void i2s_spi_setup(void) {
     /* Enable SPI1 periph. */
     spi_enable(SPI1);
 
-    // Timer3 Configuration
-    rcc_periph_reset_pulse(RST_TIM3);
-    timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+    // Timer2 Configuration
+    rcc_periph_reset_pulse(RST_TIM2);
+    timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
     // Our MCU is running at 72MHz, so we need to divide it by 72 to get 1MHz
-    timer_set_prescaler(TIM3, 72 - 1);
-    // 20 micros = 1MHz/20 = 50kHz ~ 48kHz
-    timer_set_period(TIM3, 20 - 1);
-    timer_set_oc_polarity_high(TIM3, TIM_OC1);
-    timer_set_oc_mode(TIM3, TIM_OC1, TIM_OCM_FROZEN);
-    timer_enable_irq(TIM3, TIM_DIER_CC1IE);
-    timer_enable_counter(TIM3);
-
-    // Enable the NVIC interrupt for TIM3
-    nvic_enable_irq(NVIC_TIM3_IRQ);
-
-    delay_setup();
+    timer_set_prescaler(TIM2, 72 - 1);
+    // 10 micros per word, 20 micros per frame = 50kHz ~ 48kHz
+    timer_set_period(TIM2, I2S_WORD_TICKS - 1);
+
+    // WS toggles on CC4, after the previous word has been shifted out (16 bits at 9MHz ~ 1.8us)
+    // and just ahead of the update event that sends the next word. Forcing it high first makes
+    // the first toggle pull it low for the right channel.
+    timer_set_oc_mode(TIM2, TIM_OC4, TIM_OCM_FORCE_HIGH);
+    timer_set_oc_value(TIM2, TIM_OC4, I2S_WORD_TICKS - 2);
+    timer_set_oc_polarity_high(TIM2, TIM_OC4);
+    timer_enable_oc_output(TIM2, TIM_OC4);
+    timer_set_oc_mode(TIM2, TIM_OC4, TIM_OCM_TOGGLE);
+
+    // DMA1 channel 2 (TIM2_UP): one word from the buffer into SPI1_DR per TIM2 update
+    dma_channel_reset(DMA1, DMA_CHANNEL2);
+    dma_set_peripheral_address(DMA1, DMA_CHANNEL2, (uint32_t)&SPI1_DR);
+    dma_set_memory_address(DMA1, DMA_CHANNEL2, (uint32_t)audio_buffer);
+    dma_set_number_of_data(DMA1, DMA_CHANNEL2, sizeof(audio_buffer) / sizeof(audio_buffer[0]));
+    dma_set_read_from_memory(DMA1, DMA_CHANNEL2);
+    dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL2);
+    dma_set_peripheral_size(DMA1, DMA_CHANNEL2, DMA_CCR_PSIZE_16BIT);
+    dma_set_memory_size(DMA1, DMA_CHANNEL2, DMA_CCR_MSIZE_16BIT);
+    dma_set_priority(DMA1, DMA_CHANNEL2, DMA_CCR_PL_VERY_HIGH);
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL2);
+    dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL2);
+    dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL2);
+
+    timer_enable_irq(TIM2, TIM_DIER_UDE);
+
+    // Cycle counter for measuring the render time
+    dwt_enable_cycle_counter();
+}
+
+void i2s_start(i2s_fill_cb fill) {
+    fill_callback = fill;
+    fill_callback(audio_buffer, I2S_BLOCK_FRAMES);
+    fill_callback(audio_buffer + I2S_BLOCK_FRAMES * 2, I2S_BLOCK_FRAMES);
+
+    dma_enable_channel(DMA1, DMA_CHANNEL2);
+
+    // Enable the NVIC interrupt for the audio DMA
+    nvic_set_priority(NVIC_DMA1_CHANNEL2_IRQ, I2S_IRQ_PRIORITY);
+    nvic_enable_irq(NVIC_DMA1_CHANNEL2_IRQ);
+
+    timer_enable_counter(TIM2);
+}
+
+uint32_t i2s_frame_position(void) {
+    const uint32_t words = sizeof(audio_buffer) / sizeof(audio_buffer[0]);
+    uint32_t wraps;
+    uint32_t remaining;
+    bool pending;
+
+    // Retry if the interrupt ran in between
+    do {
+        wraps = buffer_wraps;
+        remaining = DMA_CNDTR(DMA1, DMA_CHANNEL2);
+        pending = dma_get_interrupt_flag(DMA1, DMA_CHANNEL2, DMA_TCIF);
+    } while(wraps != buffer_wraps);
+
+    // The counter reloaded but the interrupt hasn't counted the wrap yet
+    if(pending && remaining > words / 2) { wraps++; }
+
+    return wraps * I2S_BLOCK_FRAMES * 2 + (words - remaining) / 2;
 }
 
-void i2s_send(uint16_t sample_right, uint16_t sample_left) {
-    // one without the light
-    gpio_clear(GPIOA, WS_PIN);
-    spi_send(SPI1, sample_right);
+static void i2s_fill(uint16_t *buffer) {
+    uint32_t start = dwt_read_cycle_counter();
+    fill_callback(buffer, I2S_BLOCK_FRAMES);
+    i2s_isr_cycles = dwt_read_cycle_counter() - start;
+    if(i2s_isr_cycles > i2s_isr_cycles_max) { i2s_isr_cycles_max = i2s_isr_cycles; }
+}
 
-    delay_us(3);
+// Half transfer: first half was sent, refill it. Complete: same for the second half.
+void dma1_channel2_isr(void) {
+    if(dma_get_interrupt_flag(DMA1, DMA_CHANNEL2, DMA_HTIF)) {
+        dma_clear_interrupt_flags(DMA1, DMA_CHANNEL2, DMA_HTIF);
+        i2s_fill(audio_buffer);
+    }
 
-    // one with the light
-    gpio_set(GPIOA, WS_PIN);
-    spi_send(SPI1, sample_left);
+    if(dma_get_interrupt_flag(DMA1, DMA_CHANNEL2, DMA_TCIF)) {
+        dma_clear_interrupt_flags(DMA1, DMA_CHANNEL2, DMA_TCIF);
+        buffer_wraps++;
+        i2s_fill(audio_buffer + I2S_BLOCK_FRAMES * 2);
+    }
 }
@@ -16,14 +16,44 @@
 // Calculation of the I²S interface bit rate
 // I2S BITRATE SAMPLE RATE WIDTH× CHANNEL× 48000 16 2×× 1.536 Mbit/s
 
+#pragma once
+
+#include <libopencm3/cm3/dwt.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/spi.h>
 #include <libopencm3/stm32/timer.h>
 
+// WS on PA3 is TIM2_CH4, toggled by the timer in hardware
 #define WS_PIN GPIO3
 
+// Highest priority, the fill has to finish within one block
+#define I2S_IRQ_PRIORITY (0 << 4)
+
+// Stereo frames per half of the ping-pong buffer
+#define I2S_BLOCK_FRAMES 32
+
+// A fill renders the half that starts I2S_BLOCK_FRAMES after the current
+// play position. Something that arrives at i2s_frame_position() is always
+// before the end of the next fill when delayed by this much.
+#define I2S_LATENCY_FRAMES (I2S_BLOCK_FRAMES * 2)
+
+// Fills frames * 2 words, right channel first
+typedef void (*i2s_fill_cb)(uint16_t *buffer, uint32_t frames);
+
+// CPU cycles spent in the fill callback, last block and worst case.
+// The block deadline is I2S_BLOCK_FRAMES * 1440 cycles at 72MHz.
+extern volatile uint32_t i2s_isr_cycles;
+extern volatile uint32_t i2s_isr_cycles_max;
+
 void i2s_spi_setup(void);
 
-void i2s_send(uint16_t sample_right, uint16_t sample_left);
+// Prime both halves of the buffer and start streaming. The callback is
+// called from the DMA interrupt every time a half has been sent.
+void i2s_start(i2s_fill_cb fill);
+
+// Frames sent since i2s_start, the first primed frame is 0. Call it from
+// the audio DMA interrupt or a lower priority.
+uint32_t i2s_frame_position(void);
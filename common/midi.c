@@ -1,5 +1,7 @@
 #include "midi.h"
 
+static usbd_device *usb_dev;
+
 usbd_device* usb_start(const char *usb_strings[]) {
     rcc_periph_clock_enable(RCC_GPIOA);
     rcc_periph_clock_enable(RCC_GPIOB);
@@ -19,6 +21,15 @@ usbd_device* usb_start(const char *usb_strings[]) {
     gpio_clear(GPIOA, GPIO12);
     for(unsigned i = 0; i < 800000; i++) { __asm__("nop"); }
 
-    return usbd_init(&st_usbfs_v1_usb_driver, &dev, &config, usb_strings, 3, usbd_control_buffer,
-                     sizeof(usbd_control_buffer));
+    usb_dev = usbd_init(&st_usbfs_v1_usb_driver, &dev, &config, usb_strings, 3, usbd_control_buffer,
+                        sizeof(usbd_control_buffer));
+    return usb_dev;
+}
+
+void usb_enable_irq(void) {
+    nvic_set_priority(NVIC_USB_LP_CAN_RX0_IRQ, USB_IRQ_PRIORITY);
+    nvic_enable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
 }
+
+// Transfers, resets and start of frame all land here
+void usb_lp_can_rx0_isr(void) { usbd_poll(usb_dev); }
@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <libopencm3/cm3/nvic.h>
 #include <libopencm3/cm3/scb.h>
 #include <libopencm3/stm32/desig.h>
 #include <libopencm3/stm32/gpio.h>
@@ -269,28 +270,34 @@ static char usb_serial_number[25]; /* 12 bytes of desig and a \0 */
 /* Buffer to be used for control requests. */
 static uint8_t usbd_control_buffer[128];
 
-/* SysEx identity message, preformatted with correct USB framing information */
+/* SysEx Universal Identity Reply, preformatted with correct USB framing information */
 static const uint8_t sysex_identity[] = {
     0x04, /* USB Framing (3 byte SysEx) */
     0xf0, /* SysEx start */
     0x7e, /* non-realtime */
-    0x00, /* Channel 0 */
+    0x00, /* Device ID */
     0x04, /* USB Framing (3 byte SysEx) */
+    0x06, /* General information */
+    0x02, /* Identity reply */
     0x7d, /* Educational/prototype manufacturer ID */
+    0x04, /* USB Framing (3 byte SysEx) */
     0x66, /* Family code (byte 1) */
     0x66, /* Family code (byte 2) */
-    0x04, /* USB Framing (3 byte SysEx) */
     0x51, /* Model number (byte 1) */
+    0x04, /* USB Framing (3 byte SysEx) */
     0x19, /* Model number (byte 2) */
     0x00, /* Version number (byte 1) */
-    0x04, /* USB Framing (3 byte SysEx) */
     0x00, /* Version number (byte 2) */
+    0x07, /* USB Framing (3 byte SysEx end) */
     0x01, /* Version number (byte 3) */
     0x00, /* Version number (byte 4) */
-    0x05, /* USB Framing (1 byte SysEx) */
     0xf7, /* SysEx end */
-    0x00, /* Padding */
-    0x00, /* Padding */
 };
 
+// Below the audio DMA (I2S_IRQ_PRIORITY), a USB burst must never delay a block
+#define USB_IRQ_PRIORITY (2 << 4)
+
 usbd_device* usb_start(const char *usb_strings[]);
+
+// The stack runs from the USB_LP interrupt from then on, register the callbacks first
+void usb_enable_irq(void);
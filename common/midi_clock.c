@@ -0,0 +1,82 @@
+#include "midi_clock.h"
+
+void midi_clock_init(MidiClock *clock) {
+    clock->tick_time = 0;
+    clock->period = 0;
+    clock->seen = 0;
+    clock->running = false;
+    clock->hold = false;
+    clock->position = 0;
+}
+
+void midi_clock_tick(MidiClock *clock, uint32_t frame) {
+    uint32_t time = frame << 8;
+    uint32_t predicted;
+    int32_t error;
+
+    if(clock->running) {
+        if(!clock->hold) { clock->position++; }
+        clock->hold = false;
+    }
+
+    if(clock->seen == 0) {
+        clock->tick_time = time;
+        clock->seen = 1;
+        return;
+    }
+
+    if(clock->seen == 1) {
+        clock->period = time - clock->tick_time;
+        clock->tick_time = time;
+        clock->seen = 2;
+        return;
+    }
+
+    predicted = clock->tick_time + clock->period;
+    error = time - predicted;
+
+    // A dropped tick or a tempo jump, start over from this one
+    if(error > clock->period / 2 || error < -clock->period / 2) {
+        clock->tick_time = time;
+        clock->seen = 1;
+        return;
+    }
+
+    clock->period += error >> MIDI_CLOCK_BETA;
+    clock->tick_time = predicted + (error >> MIDI_CLOCK_ALPHA);
+}
+
+void midi_clock_start(MidiClock *clock) {
+    clock->position = 0;
+    clock->running = true;
+    clock->hold = true;
+}
+
+void midi_clock_continue(MidiClock *clock) { clock->running = true; }
+
+void midi_clock_stop(MidiClock *clock) { clock->running = false; }
+
+void midi_clock_song_position(MidiClock *clock, uint16_t sixteenths) {
+    clock->position = sixteenths * (MIDI_CLOCK_PPQN / 4);
+    clock->hold = true;
+}
+
+uint32_t midi_clock_tempo(const MidiClock *clock, uint32_t sample_rate) {
+    if(!midi_clock_locked(clock) || clock->period <= 0) { return 0; }
+    // 60 * rate / (ppqn * period), period is Q8 and so is the result
+    return (uint32_t)(((uint64_t)60 * sample_rate << 16) / ((uint64_t)MIDI_CLOCK_PPQN * clock->period));
+}
+
+uint32_t midi_clock_position(const MidiClock *clock, uint32_t frame) {
+    uint64_t ticks = (uint64_t)clock->position << 16;
+    int32_t since;
+
+    // Before the first tick after start or a song position the transport sits on it
+    if(clock->running && !clock->hold && midi_clock_locked(clock)) {
+        since = (frame << 8) - clock->tick_time;
+        if(since >= clock->period) { since = clock->period - 1; }
+        if(since > 0) { ticks += ((int64_t)since << 16) / clock->period; }
+    }
+
+    return ticks / MIDI_CLOCK_PPQN;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// MIDI clock follower. Clock ticks (24 per beat) are stamped with the
+// output frame they arrived at, a second order PLL filters out the USB
+// jitter and gives the tempo and the beat position between ticks.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MIDI_CLOCK_PPQN 24
+
+// PLL gains, phase 1/2^ALPHA and period 1/2^BETA of the error per tick
+#define MIDI_CLOCK_ALPHA 3
+#define MIDI_CLOCK_BETA 7
+
+typedef struct MidiClock {
+    // Filtered time of the last tick and the tick period, Q8 frames
+    uint32_t tick_time;
+    int32_t period;
+    // Ticks seen since lock was lost, 2 and up is locked
+    uint8_t seen;
+    // Transport state, the position only advances while running
+    bool running;
+    // The next tick is at position instead of after it, after start or a song position
+    bool hold;
+    // Clock ticks from the start of the song to the last tick
+    uint32_t position;
+} MidiClock;
+
+void midi_clock_init(MidiClock *clock);
+
+// 0xF8 at this output frame
+void midi_clock_tick(MidiClock *clock, uint32_t frame);
+
+// 0xFA, 0xFB and 0xFC
+void midi_clock_start(MidiClock *clock);
+void midi_clock_continue(MidiClock *clock);
+void midi_clock_stop(MidiClock *clock);
+
+// 0xF2, in sixteenth notes
+void midi_clock_song_position(MidiClock *clock, uint16_t sixteenths);
+
+static inline bool midi_clock_locked(const MidiClock *clock) { return clock->seen >= 2; }
+
+// Beats per minute, Q8. 0 when not locked.
+uint32_t midi_clock_tempo(const MidiClock *clock, uint32_t sample_rate);
+
+// Song position at frame in beats, Q16. Between ticks it is interpolated
+// with the filtered period and never runs past the next tick.
+uint32_t midi_clock_position(const MidiClock *clock, uint32_t frame);
@@ -0,0 +1,86 @@
+#include "midi_parser.h"
+
+// Table 4-1 of the USB-MIDI 1.0 spec, MIDI bytes per code index number
+static const uint8_t cin_lengths[16] = {0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1};
+
+uint8_t midi_usb_cin_length(uint8_t cin) { return cin_lengths[cin & 0x0F]; }
+
+bool midi_usb_decode(const uint8_t *packet, MidiEvent *event) {
+    uint8_t cin = packet[0] & 0x0F;
+
+    if(cin_lengths[cin] == 0) { return false; }
+
+    // Channel voice messages have the status nibble as CIN
+    if(cin >= 0x8 && cin <= 0xE && (packet[1] >> 4) != cin) { return false; }
+
+    // SysEx and system packets pass through as they are
+    event->header = packet[0];
+    event->status = packet[1];
+    event->data1 = packet[2];
+    event->data2 = packet[3];
+    if(cin >= 0x8) {
+        event->data1 &= 0x7F;
+        event->data2 &= 0x7F;
+    }
+    event->time = 0;
+    event->arrival = 0;
+    return true;
+}
+
+void midi_dispatch(const MidiEvent *event, const MidiHandlers *handlers) {
+    uint8_t channel = event->status & 0x0F;
+
+    switch(event->status & 0xF0) {
+        case MIDI_NOTE_ON:
+            // Velocity 0 is a note-off by convention
+            if(event->data2 > 0) {
+                if(handlers->note_on) { handlers->note_on(channel, event->data1, event->data2); }
+                break;
+            }
+            // fall through
+        case MIDI_NOTE_OFF:
+            if(handlers->note_off) { handlers->note_off(channel, event->data1); }
+            break;
+
+        case MIDI_POLY_PRESSURE:
+            if(handlers->poly_pressure) { handlers->poly_pressure(channel, event->data1, event->data2); }
+            break;
+
+        case MIDI_CONTROL_CHANGE:
+            if(handlers->control_change) { handlers->control_change(channel, event->data1, event->data2); }
+            break;
+
+        case MIDI_PROGRAM_CHANGE:
+            if(handlers->program_change) { handlers->program_change(channel, event->data1); }
+            break;
+
+        case MIDI_CHANNEL_PRESSURE:
+            if(handlers->channel_pressure) { handlers->channel_pressure(channel, event->data1); }
+            break;
+
+        case MIDI_PITCH_BEND:
+            if(handlers->pitch_bend) { handlers->pitch_bend(channel, event->data1 | (event->data2 << 7)); }
+            break;
+
+        case 0xF0:
+            if(event->status == 0xF0 || event->status == 0xF7) { break; }
+            if(handlers->system) { handlers->system(event->status, event->data1, event->data2); }
+            break;
+
+        default: break;
+    }
+}
+
+uint32_t midi_usb_parse(const uint8_t *buf, uint32_t len, midi_event_cb sink) {
+    uint32_t count = 0;
+    MidiEvent event;
+
+    // Trailing bytes of an incomplete packet are dropped
+    for(; len >= 4; buf += 4, len -= 4) {
+        if(!midi_usb_decode(buf, &event)) { continue; }
+        sink(&event);
+        count++;
+    }
+
+    return count;
+}
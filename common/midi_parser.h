@@ -0,0 +1,57 @@
+#pragma once
+
+// USB-MIDI 1.0 event parser. Hardware independent, the USB callbacks hand
+// it whole bulk packets.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Channel voice status bytes, the low nibble is the channel
+#define MIDI_NOTE_OFF 0x80
+#define MIDI_NOTE_ON 0x90
+#define MIDI_POLY_PRESSURE 0xA0
+#define MIDI_CONTROL_CHANGE 0xB0
+#define MIDI_PROGRAM_CHANGE 0xC0
+#define MIDI_CHANNEL_PRESSURE 0xD0
+#define MIDI_PITCH_BEND 0xE0
+
+// One MIDI message as carried by a USB-MIDI event packet
+typedef struct MidiEvent {
+    // USB-MIDI header byte: cable number << 4 | code index number
+    uint8_t header;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    // Frame the event is due at, stamped by the receiving side
+    uint32_t time;
+    // Cycle counter on arrival, for the latency statistics
+    uint32_t arrival;
+} MidiEvent;
+
+// Any of these can be NULL
+typedef struct MidiHandlers {
+    void (*note_on)(uint8_t channel, uint8_t note, uint8_t velocity);
+    void (*note_off)(uint8_t channel, uint8_t note);
+    void (*poly_pressure)(uint8_t channel, uint8_t note, uint8_t pressure);
+    void (*control_change)(uint8_t channel, uint8_t cc, uint8_t value);
+    void (*program_change)(uint8_t channel, uint8_t program);
+    void (*channel_pressure)(uint8_t channel, uint8_t pressure);
+    // 14-bit value, 8192 is the center
+    void (*pitch_bend)(uint8_t channel, uint16_t value);
+    // System common and real-time messages, SysEx excluded
+    void (*system)(uint8_t status, uint8_t data1, uint8_t data2);
+} MidiHandlers;
+
+// Number of MIDI bytes in a USB-MIDI packet with this code index number, 0 if reserved
+uint8_t midi_usb_cin_length(uint8_t cin);
+
+// Decode one 4-byte USB-MIDI event packet, returns false for padding,
+// reserved code index numbers and malformed channel voice messages
+bool midi_usb_decode(const uint8_t *packet, MidiEvent *event);
+
+void midi_dispatch(const MidiEvent *event, const MidiHandlers *handlers);
+
+typedef void (*midi_event_cb)(const MidiEvent *event);
+
+// Walk every event packet in a bulk transfer, returns the number of events passed to sink
+uint32_t midi_usb_parse(const uint8_t *buf, uint32_t len, midi_event_cb sink);
@@ -0,0 +1,48 @@
+#include "midi_queue.h"
+
+void midi_queue_init(MidiQueue *queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->overflows = 0;
+    queue->max_depth = 0;
+}
+
+bool midi_queue_push(MidiQueue *queue, const MidiEvent *event) {
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    if(head - tail >= MIDI_QUEUE_SIZE) {
+        queue->overflows++;
+        return false;
+    }
+
+    queue->events[head & (MIDI_QUEUE_SIZE - 1)] = *event;
+    // The slot has to be written before the consumer can see it
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+    if(head + 1 - tail > queue->max_depth) { queue->max_depth = head + 1 - tail; }
+    return true;
+}
+
+const MidiEvent *midi_queue_peek(MidiQueue *queue) {
+    uint32_t tail = queue->tail;
+
+    if(__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == tail) { return NULL; }
+    return &queue->events[tail & (MIDI_QUEUE_SIZE - 1)];
+}
+
+bool midi_queue_pop(MidiQueue *queue, MidiEvent *event) {
+    uint32_t tail = queue->tail;
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+    if(head == tail) { return false; }
+
+    *event = queue->events[tail & (MIDI_QUEUE_SIZE - 1)];
+    // Hand the slot back only after it has been read
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t midi_queue_depth(const MidiQueue *queue) {
+    return __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Lock-free single producer, single consumer ring of MIDI events. The USB
+// side pushes, the audio interrupt pops at block boundaries. Each index is
+// only written by one side and published with release/acquire ordering.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "midi_parser.h"
+
+// Power of two, one USB packet holds up to 16 events
+#ifndef MIDI_QUEUE_SIZE
+#define MIDI_QUEUE_SIZE 64
+#endif
+
+#if MIDI_QUEUE_SIZE & (MIDI_QUEUE_SIZE - 1)
+#error "MIDI_QUEUE_SIZE must be a power of two"
+#endif
+
+typedef struct MidiQueue {
+    MidiEvent events[MIDI_QUEUE_SIZE];
+    // Free running counters, written by the producer and consumer respectively
+    uint32_t head;
+    uint32_t tail;
+    // Events dropped because the ring was full and the deepest it got, written by the producer
+    uint32_t overflows;
+    uint32_t max_depth;
+} MidiQueue;
+
+void midi_queue_init(MidiQueue *queue);
+
+// Producer side, returns false and counts an overflow when full
+bool midi_queue_push(MidiQueue *queue, const MidiEvent *event);
+
+// Consumer side, the oldest event without removing it or NULL when empty.
+// It stays valid until the next pop.
+const MidiEvent *midi_queue_peek(MidiQueue *queue);
+
+// Consumer side, returns false when empty
+bool midi_queue_pop(MidiQueue *queue, MidiEvent *event);
+
+// Approximate when called from a third context
+uint32_t midi_queue_depth(const MidiQueue *queue);
@@ -0,0 +1,32 @@
+#include "midi_stats.h"
+
+uint32_t midi_stats_reply(const MidiStatsReport *report, uint8_t *reply) {
+    uint32_t values[MIDI_STATS_VALUES];
+    uint32_t n = 0;
+    uint32_t i, j;
+
+    for(i = 0; i < 16; i++) { values[n++] = report->midi.events[i]; }
+    values[n++] = report->midi.total;
+    values[n++] = report->queue_overflows;
+    values[n++] = report->queue_max_depth;
+    values[n++] = report->latency_last;
+    values[n++] = report->latency_max;
+    values[n++] = report->latency_average;
+    values[n++] = report->sysex_overflows;
+    values[n++] = report->sysex_dropped;
+    values[n++] = report->sysex_unhandled;
+    values[n++] = report->tx_overflows;
+    values[n++] = report->fill_cycles_max;
+    values[n++] = report->voice_limit;
+    values[n++] = report->voice_cycles;
+
+    reply[0] = 0xF0;
+    reply[1] = 0x7D;
+    reply[2] = 0x02;
+    for(i = 0; i < n; i++) {
+        for(j = 0; j < 5; j++) { reply[3 + i * 5 + j] = (values[i] >> (j * 7)) & 0x7F; }
+    }
+    reply[3 + n * 5] = 0xF7;
+
+    return 4 + n * 5;
+}
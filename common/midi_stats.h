@@ -0,0 +1,58 @@
+#pragma once
+
+// MIDI input counters, by message type. Counted on the receiving side,
+// which is a single interrupt priority.
+
+#include <stdint.h>
+
+#include "midi_parser.h"
+
+typedef struct MidiStats {
+    // Events per USB-MIDI code index number, which is the message type:
+    // 0x8 note off to 0xE pitch bend, 0x4 to 0x7 SysEx, 0xF single bytes
+    uint32_t events[16];
+    uint32_t total;
+} MidiStats;
+
+static inline void midi_stats_init(MidiStats *stats) {
+    uint8_t i;
+
+    for(i = 0; i < 16; i++) { stats->events[i] = 0; }
+    stats->total = 0;
+}
+
+static inline void midi_stats_count(MidiStats *stats, const MidiEvent *event) {
+    stats->events[event->header & 0x0F]++;
+    stats->total++;
+}
+
+// Everything the F0 7D 02 F7 stats query returns, in reply order
+typedef struct MidiStatsReport {
+    MidiStats midi;
+    // Synth event queue, see SynthStats
+    uint32_t queue_overflows;
+    uint32_t queue_max_depth;
+    // Arrival to audible in cycles
+    uint32_t latency_last;
+    uint32_t latency_max;
+    uint32_t latency_average;
+    // SysEx receiver errors, see SysexReceiver
+    uint32_t sysex_overflows;
+    uint32_t sysex_dropped;
+    uint32_t sysex_unhandled;
+    uint32_t tx_overflows;
+    // Worst audio fill time in cycles
+    uint32_t fill_cycles_max;
+    // From the boot time voice calibration
+    uint32_t voice_limit;
+    uint32_t voice_cycles;
+} MidiStatsReport;
+
+#define MIDI_STATS_VALUES 29
+#define MIDI_STATS_REPLY_SIZE (3 + MIDI_STATS_VALUES * 5 + 1)
+
+// F0 7D 02 <values> F7 into reply[MIDI_STATS_REPLY_SIZE], returns the
+// length. Every value is 32 bits in five 7-bit bytes, least significant
+// first, in MidiStatsReport order: events per CIN 0x0 to 0xF, events
+// total, then the fields from queue_overflows on.
+uint32_t midi_stats_reply(const MidiStatsReport *report, uint8_t *reply);
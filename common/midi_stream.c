@@ -0,0 +1,108 @@
+#include "midi_stream.h"
+
+// Data bytes after a system common status, 0xF0 to 0xF7
+static const uint8_t system_lengths[8] = {0, 1, 2, 1, 0, 0, 0, 0};
+
+static void midi_stream_emit(MidiStream *stream, uint8_t cin, const uint8_t *bytes, midi_event_cb sink) {
+    MidiEvent event = {(stream->cable << 4) | cin, bytes[0], 0, 0, 0, 0};
+    uint8_t length = midi_usb_cin_length(cin);
+
+    if(length > 1) { event.data1 = bytes[1]; }
+    if(length > 2) { event.data2 = bytes[2]; }
+    sink(&event);
+}
+
+// SysEx goes out three bytes at a time, the last packet carries 0xF7
+static void midi_stream_sysex(MidiStream *stream, uint8_t byte, midi_event_cb sink) {
+    stream->data[stream->count++] = byte;
+
+    if(byte == 0xF7) {
+        // CIN 0x5, 0x6, 0x7 for 1, 2, 3 bytes
+        midi_stream_emit(stream, 0x4 + stream->count, stream->data, sink);
+        stream->count = 0;
+        stream->sysex = false;
+    } else if(stream->count == 3) {
+        midi_stream_emit(stream, 0x4, stream->data, sink);
+        stream->count = 0;
+    }
+}
+
+static void midi_stream_status(MidiStream *stream, uint8_t byte, midi_event_cb sink) {
+    if(byte == 0xF7 && stream->sysex) {
+        midi_stream_sysex(stream, byte, sink);
+        return;
+    }
+
+    // Any other status but real-time ends a SysEx, a truncated one is dropped
+    stream->sysex = false;
+    stream->count = 0;
+
+    if(byte < 0xF0) {
+        stream->status = byte;
+        stream->expected = (byte & 0xE0) == 0xC0 ? 1 : 2;
+        return;
+    }
+
+    // System common cancels running status
+    stream->status = 0;
+
+    if(byte == 0xF0) {
+        stream->sysex = true;
+        midi_stream_sysex(stream, byte, sink);
+    } else if(byte == 0xF6) {
+        // Tune request, single byte
+        midi_stream_emit(stream, 0x5, &byte, sink);
+    } else if(system_lengths[byte & 0x07] > 0) {
+        stream->status = byte;
+        stream->expected = system_lengths[byte & 0x07];
+        stream->data[0] = byte;
+    }
+}
+
+static void midi_stream_data(MidiStream *stream, uint8_t byte, midi_event_cb sink) {
+    if(stream->sysex) {
+        midi_stream_sysex(stream, byte, sink);
+        return;
+    }
+
+    // Data without a status to go with it
+    if(stream->status == 0) { return; }
+
+    stream->data[0] = stream->status;
+    stream->data[1 + stream->count++] = byte;
+    if(stream->count < stream->expected) { return; }
+
+    if(stream->status < 0xF0) {
+        midi_stream_emit(stream, stream->status >> 4, stream->data, sink);
+    } else {
+        // CIN 0x2 and 0x3 for two and three byte system common, no running status
+        midi_stream_emit(stream, 0x1 + stream->expected, stream->data, sink);
+        stream->status = 0;
+    }
+    stream->count = 0;
+}
+
+void midi_stream_init(MidiStream *stream, uint8_t cable) {
+    stream->status = 0;
+    stream->expected = 0;
+    stream->count = 0;
+    stream->sysex = false;
+    stream->cable = cable & 0x0F;
+}
+
+void midi_stream_parse(MidiStream *stream, const uint8_t *bytes, uint32_t len, midi_event_cb sink) {
+    uint8_t byte;
+
+    while(len--) {
+        byte = *bytes++;
+
+        if(byte >= 0xF8) {
+            // Real-time goes out right away and leaves the message in progress alone
+            midi_stream_emit(stream, 0xF, &byte, sink);
+        } else if(byte & 0x80) {
+            midi_stream_status(stream, byte, sink);
+        } else {
+            midi_stream_data(stream, byte, sink);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Incremental parser for a raw MIDI byte stream such as DIN MIDI. It
+// handles running status, real-time bytes in the middle of a message and
+// SysEx, and emits the same USB-MIDI event packets the USB side gets.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "midi_parser.h"
+
+typedef struct MidiStream {
+    // Running status, 0 when there is none
+    uint8_t status;
+    // Data bytes the current message needs
+    uint8_t expected;
+    // Bytes collected in data, for SysEx up to one packet's worth
+    uint8_t count;
+    uint8_t data[3];
+    bool sysex;
+    // USB-MIDI cable number the events get tagged with
+    uint8_t cable;
+} MidiStream;
+
+void midi_stream_init(MidiStream *stream, uint8_t cable);
+
+void midi_stream_parse(MidiStream *stream, const uint8_t *bytes, uint32_t len, midi_event_cb sink);
@@ -0,0 +1,73 @@
+#include "midi_tx.h"
+
+#include "midi_queue.h"
+
+static usbd_device *tx_dev;
+
+// Producer is the caller of midi_tx_send, consumer is the USB context
+static MidiQueue tx_queue;
+
+// Packet that didn't fit into the endpoint yet, it goes out before anything newer
+static uint8_t packet[MIDI_TX_PACKET_SIZE];
+static uint16_t packet_len = 0;
+
+static void midi_tx_flush(void) {
+    MidiEvent event;
+
+    if(tx_dev == NULL) { return; }
+
+    if(packet_len == 0) {
+        while(packet_len < MIDI_TX_PACKET_SIZE && midi_queue_pop(&tx_queue, &event)) {
+            packet[packet_len++] = event.header;
+            packet[packet_len++] = event.status;
+            packet[packet_len++] = event.data1;
+            packet[packet_len++] = event.data2;
+        }
+        if(packet_len == 0) { return; }
+    }
+
+    // Returns 0 while the previous packet is still waiting for the host
+    if(usbd_ep_write_packet(tx_dev, MIDI_TX_ENDPOINT, packet, packet_len) != 0) { packet_len = 0; }
+}
+
+// The host took the previous packet, send whatever queued up meanwhile
+static void midi_tx_complete(usbd_device *usbd_dev, uint8_t ep) {
+    (void)usbd_dev;
+    (void)ep;
+    midi_tx_flush();
+}
+
+void midi_tx_init(usbd_device *usbd_dev) {
+    midi_queue_init(&tx_queue);
+    usbd_register_sof_callback(usbd_dev, midi_tx_flush);
+}
+
+void midi_tx_set_config(usbd_device *usbd_dev) {
+    tx_dev = usbd_dev;
+    packet_len = 0;
+    usbd_ep_setup(usbd_dev, MIDI_TX_ENDPOINT, USB_ENDPOINT_ATTR_BULK, MIDI_TX_PACKET_SIZE, midi_tx_complete);
+}
+
+bool midi_tx_send(const MidiEvent *event) { return midi_queue_push(&tx_queue, event); }
+
+bool midi_tx_sysex(const uint8_t *message, uint32_t len) {
+    MidiEvent event = {0x04, 0, 0, 0, 0, 0};
+    uint32_t remaining;
+    uint32_t i;
+
+    // Only the consumer frees space, so it can't shrink after this check
+    if((len + 2) / 3 > MIDI_QUEUE_SIZE - midi_queue_depth(&tx_queue)) { return false; }
+
+    for(i = 0; i < len; i += 3) {
+        remaining = len - i;
+        // CIN 0x4 for three bytes that continue, 0x5 to 0x7 for the last one to three
+        event.header = remaining > 3 ? 0x04 : 0x04 + remaining;
+        event.status = message[i];
+        event.data1 = remaining > 1 ? message[i + 1] : 0;
+        event.data2 = remaining > 2 ? message[i + 2] : 0;
+        midi_queue_push(&tx_queue, &event);
+    }
+    return true;
+}
+
+uint32_t midi_tx_overflows(void) { return tx_queue.overflows; }
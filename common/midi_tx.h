@@ -0,0 +1,30 @@
+#pragma once
+
+// USB-MIDI IN transmit ring. Events are queued without blocking and sent
+// on endpoint 0x81 up to 16 per 64-byte bulk packet, from the endpoint
+// complete callback or the next start of frame.
+
+#include <libopencm3/usb/usbd.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "midi_parser.h"
+
+#define MIDI_TX_ENDPOINT 0x81
+#define MIDI_TX_PACKET_SIZE 64
+
+// Registers the start of frame flush, call once after usb_start
+void midi_tx_init(usbd_device *usbd_dev);
+
+// Sets up the IN endpoint, call from the set config callback
+void midi_tx_set_config(usbd_device *usbd_dev);
+
+// Queue one event, header byte included. Returns false when the ring is full.
+bool midi_tx_send(const MidiEvent *event);
+
+// Queue a whole SysEx message, 0xF0 to 0xF7, split into event packets.
+// Nothing is queued and false returned if it doesn't fit.
+bool midi_tx_sysex(const uint8_t *message, uint32_t len);
+
+// Events dropped because the ring was full
+uint32_t midi_tx_overflows(void);
@@ -0,0 +1,81 @@
+#include "midi_uart.h"
+
+#include "midi_stream.h"
+
+static uint8_t rx_buffer[MIDI_UART_BUFFER];
+
+// Where the parser is in rx_buffer, DMA writes ahead of it
+static uint32_t rx_tail = 0;
+
+static MidiStream stream;
+static midi_event_cb event_sink;
+
+void midi_uart_setup(midi_event_cb sink) {
+    event_sink = sink;
+    midi_stream_init(&stream, MIDI_UART_CABLE);
+
+    rcc_periph_clock_enable(RCC_GPIOA);
+    rcc_periph_clock_enable(RCC_USART1);
+    rcc_periph_clock_enable(RCC_DMA1);
+
+    // RX on PA10, the opto-isolator output idles high
+    gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, GPIO10);
+
+    usart_set_baudrate(USART1, 31250);
+    usart_set_databits(USART1, 8);
+    usart_set_stopbits(USART1, USART_STOPBITS_1);
+    usart_set_parity(USART1, USART_PARITY_NONE);
+    usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
+    usart_set_mode(USART1, USART_MODE_RX);
+
+    // DMA1 channel 5 (USART1_RX): every received byte into the circular buffer
+    dma_channel_reset(DMA1, DMA_CHANNEL5);
+    dma_set_peripheral_address(DMA1, DMA_CHANNEL5, (uint32_t)&USART1_DR);
+    dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t)rx_buffer);
+    dma_set_number_of_data(DMA1, DMA_CHANNEL5, MIDI_UART_BUFFER);
+    dma_set_read_from_peripheral(DMA1, DMA_CHANNEL5);
+    dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL5);
+    dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_8BIT);
+    dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_8BIT);
+    dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_MEDIUM);
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL5);
+    dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL5);
+    dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL5);
+    dma_enable_channel(DMA1, DMA_CHANNEL5);
+
+    // Idle line marks the end of a burst, half/full transfer keeps up with long ones
+    usart_enable_rx_dma(USART1);
+    USART_CR1(USART1) |= USART_CR1_IDLEIE;
+
+    nvic_set_priority(NVIC_DMA1_CHANNEL5_IRQ, MIDI_UART_IRQ_PRIORITY);
+    nvic_set_priority(NVIC_USART1_IRQ, MIDI_UART_IRQ_PRIORITY);
+    nvic_enable_irq(NVIC_DMA1_CHANNEL5_IRQ);
+    nvic_enable_irq(NVIC_USART1_IRQ);
+
+    usart_enable(USART1);
+}
+
+// Parse everything DMA wrote since the last call
+static void midi_uart_drain(void) {
+    uint32_t head = (MIDI_UART_BUFFER - DMA_CNDTR(DMA1, DMA_CHANNEL5)) % MIDI_UART_BUFFER;
+
+    if(head < rx_tail) {
+        midi_stream_parse(&stream, rx_buffer + rx_tail, MIDI_UART_BUFFER - rx_tail, event_sink);
+        rx_tail = 0;
+    }
+    midi_stream_parse(&stream, rx_buffer + rx_tail, head - rx_tail, event_sink);
+    rx_tail = head;
+}
+
+void usart1_isr(void) {
+    // Reading SR then DR clears the idle flag, DMA already took the data
+    if(USART_SR(USART1) & USART_SR_IDLE) {
+        (void)USART_DR(USART1);
+        midi_uart_drain();
+    }
+}
+
+void dma1_channel5_isr(void) {
+    dma_clear_interrupt_flags(DMA1, DMA_CHANNEL5, DMA_HTIF | DMA_TCIF);
+    midi_uart_drain();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// DIN MIDI input on USART1 RX (PA10) at 31250 baud. DMA1 channel 5 fills a
+// circular buffer, the idle line and half/full transfer interrupts hand the
+// new bytes to the stream parser, nothing runs per byte.
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/usart.h>
+
+#include "midi_parser.h"
+
+// About 20ms of back to back bytes
+#define MIDI_UART_BUFFER 64
+
+// Same as USB_IRQ_PRIORITY, the two MIDI inputs never preempt each other
+// and stay a single producer for the synth queue
+#define MIDI_UART_IRQ_PRIORITY (2 << 4)
+
+// Events are tagged with this USB-MIDI cable number
+#define MIDI_UART_CABLE 1
+
+// sink is called from the interrupt for every complete event
+void midi_uart_setup(midi_event_cb sink);
@@ -0,0 +1,63 @@
+#include "mixer.h"
+
+#include <string.h>
+
+#include "dsp.h"
+
+// Table step above the knee, the table covers 128 steps (4x full scale)
+#define MIXER_STEP_BITS 10
+#define MIXER_STEPS 128
+
+// knee + (32767 - knee) * tanh(i * 1024 / (32767 - knee))
+static const int16_t soft_clip_table[MIXER_STEPS + 1] = {
+    16384, 17407, 18421, 19420, 20397, 21344, 22255, 23127, 23955, 24737, 25470, 26155,
+    26790, 27377, 27917, 28411, 28862, 29272, 29643, 29979, 30282, 30554, 30799, 31017,
+    31213, 31388, 31544, 31683, 31807, 31917, 32014, 32101, 32178, 32246, 32306, 32360,
+    32407, 32449, 32486, 32519, 32548, 32573, 32596, 32616, 32634, 32649, 32663, 32675,
+    32686, 32696, 32704, 32711, 32718, 32724, 32729, 32733, 32737, 32741, 32744, 32746,
+    32749, 32751, 32753, 32755, 32756, 32757, 32758, 32759, 32760, 32761, 32762, 32762,
+    32763, 32763, 32764, 32764, 32765, 32765, 32765, 32765, 32766, 32766, 32766, 32766,
+    32766, 32766, 32766, 32766, 32766, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767
+};
+
+// Constant cost: one table pair load and one SMLAD above the knee
+static inline int32_t mixer_soft_clip(int32_t x) {
+    uint32_t a = x < 0 ? -x : x;
+    uint32_t index, weight, pair;
+    int32_t y;
+
+    if(a < MIXER_KNEE) { return x; }
+
+    a -= MIXER_KNEE;
+    index = a >> MIXER_STEP_BITS;
+    if(index >= MIXER_STEPS) {
+        y = soft_clip_table[MIXER_STEPS];
+    } else {
+        // Neighbouring entries as one packed pair, interpolated with Q10 weights
+        weight = a & ((1 << MIXER_STEP_BITS) - 1);
+        memcpy(&pair, &soft_clip_table[index], sizeof(pair));
+        y = dsp_smlad(pair, dsp_pack16((1 << MIXER_STEP_BITS) - weight, weight), 0) >> MIXER_STEP_BITS;
+    }
+
+    return x < 0 ? -y : y;
+}
+
+uint32_t mixer_output(uint16_t *out, const int32_t *mix, uint32_t frames) {
+    uint32_t limited = 0;
+
+    while(frames--) {
+        int32_t sample = *mix++;
+        limited += (uint32_t)(sample + MIXER_KNEE) >= 2 * MIXER_KNEE;
+
+        sample = dsp_ssat16(mixer_soft_clip(sample));
+        // Flipping the sign bit is the same as adding 32768
+        uint32_t frame = dsp_pack16(sample, sample) ^ 0x80008000u;
+        memcpy(out, &frame, sizeof(frame));
+        out += 2;
+    }
+
+    return limited;
+}
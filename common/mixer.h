@@ -0,0 +1,14 @@
+#pragma once
+
+// Output stage. The voices are summed into a 32-bit mix buffer, which has
+// plenty of headroom, and this limiter folds it into the int16 range with
+// a soft knee instead of letting it wrap.
+
+#include <stdint.h>
+
+// Below the knee the limiter is linear
+#define MIXER_KNEE 16384
+
+// Soft clip a mix block and write it as offset binary stereo frames, right
+// channel first. Returns how many samples went over the knee.
+uint32_t mixer_output(uint16_t *out, const int32_t *mix, uint32_t frames);
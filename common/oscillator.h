@@ -0,0 +1,78 @@
+#pragma once
+
+// Band-limited fixed point oscillators, PolyBLEP for the saw and square
+// steps and PolyBLAMP for the triangle corners.
+//
+// Phase and increment are fractions of a cycle in 0.32 fixed point, the
+// output is Q15 in the same range as the old naive saw. The corrections
+// only run within one increment of a discontinuity, the rest of the cycle
+// costs a handful of instructions per voice.
+
+#include <stdint.h>
+
+enum {
+    OSC_SAW = 0,
+    OSC_SQUARE,
+    OSC_TRIANGLE,
+    OSC_WAVEFORMS,
+};
+
+// t / dt in Q15 for t < dt. Both get normalized so that the division
+// works on 16 significant bits regardless of the note.
+static inline int32_t osc_ratio(uint32_t t, uint32_t dt) {
+    int shift = __builtin_clz(dt);
+    return (int32_t)((((t << shift) >> 16) << 15) / ((dt << shift) >> 16));
+}
+
+// Residual of a unit step at phase 0, Q15
+static inline int32_t osc_blep(uint32_t t, uint32_t dt) {
+    int32_t r;
+    if(t < dt) {
+        r = 32768 - osc_ratio(t, dt);
+        return -((r * r) >> 15);
+    }
+    if(-t < dt) {
+        r = 32768 - osc_ratio(-t, dt);
+        return (r * r) >> 15;
+    }
+    return 0;
+}
+
+// Residual of a unit slope change at phase 0, Q15, without the dt factor
+static inline int32_t osc_blamp(uint32_t t, uint32_t dt) {
+    uint32_t d = t < -t ? t : -t;
+    int32_t r;
+    if(d >= dt) { return 0; }
+    r = 32768 - osc_ratio(d, dt);
+    r = (((r * r) >> 15) * r) >> 15;
+    return r / 3;
+}
+
+// One sample of the given waveform at phase t with increment dt
+static inline int32_t osc_sample(uint8_t waveform, uint32_t t, uint32_t dt) {
+    int32_t y;
+
+    if(dt == 0) { dt = 1; }
+
+    switch(waveform) {
+        case OSC_SQUARE:
+            y = t < 0x80000000u ? 32767 : -32768;
+            y += osc_blep(t, dt) - osc_blep(t + 0x80000000u, dt);
+            break;
+
+        case OSC_TRIANGLE:
+            // Peak at phase 0, trough at half a cycle, slope change of 8 at both
+            y = (int32_t)(t >> 16) - 32768;
+            y = 2 * (y < 0 ? -y : y) - 32768;
+            if(y > 32767) { y = 32767; }
+            y += ((osc_blamp(t + 0x80000000u, dt) - osc_blamp(t, dt)) * (int32_t)(dt >> 17) * 4) >> 15;
+            break;
+
+        default:
+            y = (int32_t)(t >> 16) - 32768;
+            y -= osc_blep(t, dt);
+            break;
+    }
+
+    return y;
+}
@@ -0,0 +1,125 @@
+#include "params.h"
+
+#include "control.h"
+
+// NRPN selection and data entry controllers
+#define CC_DATA_ENTRY 6
+#define CC_DATA_ENTRY_LSB 38
+#define CC_NRPN_LSB 98
+#define CC_NRPN_MSB 99
+#define CC_RPN_LSB 100
+#define CC_RPN_MSB 101
+
+// Nothing selected, also what an RPN selection turns into since there are none
+#define NRPN_NULL 0x3FFF
+
+static int32_t params_scale(const ParamDef *def, uint16_t value) {
+    int64_t x = value > PARAM_FULL ? PARAM_FULL : value;
+
+    if(def->curve == PARAM_SQUARE) { x = x * x / PARAM_FULL; }
+    return def->min + (int32_t)(((int64_t)(def->max - def->min) * x) / PARAM_FULL);
+}
+
+void params_init(Params *params, const ParamDef *defs, uint8_t count) {
+    const ParamDef *def;
+    uint8_t slot = 0;
+    uint8_t i, j, slots;
+
+    params->defs = defs;
+    params->count = count;
+    params->moving = 0;
+
+    for(i = 0; i < 128; i++) {
+        params->cc_map[i] = PARAM_NONE;
+        params->nrpn_map[i] = PARAM_NONE;
+    }
+    for(i = 0; i < 16; i++) {
+        params->nrpn[i] = NRPN_NULL;
+        params->data_msb[i] = 0;
+    }
+
+    for(i = 0; i < count && i < PARAM_MAX; i++) {
+        def = &defs[i];
+        slots = def->flags & PARAM_PER_CHANNEL ? 16 : 1;
+        if(slot + slots > PARAM_SLOTS) { break; }
+
+        if(def->cc < 128) { params->cc_map[def->cc] = i; }
+        if(def->nrpn < 128) { params->nrpn_map[def->nrpn] = i; }
+
+        params->slot[i] = slot;
+        for(j = 0; j < slots; j++, slot++) {
+            params->slot_param[slot] = i;
+            params->target[slot] = params_scale(def, def->initial);
+            params->value[slot] = params->target[slot];
+        }
+    }
+    params->count = i;
+}
+
+void params_set(Params *params, uint8_t param, uint8_t channel, uint16_t value) {
+    const ParamDef *def;
+    uint8_t slot;
+
+    if(param >= params->count) { return; }
+    def = &params->defs[param];
+    slot = params->slot[param];
+    if(def->flags & PARAM_PER_CHANNEL) { slot += channel & 0x0F; }
+
+    params->target[slot] = params_scale(def, value);
+    params->moving |= (uint64_t)1 << slot;
+}
+
+// Data entry for the selected NRPN
+static void params_data_entry(Params *params, uint8_t channel, uint16_t value) {
+    uint16_t nrpn = params->nrpn[channel];
+    uint8_t param;
+
+    if((nrpn >> 7) != PARAM_NRPN_BANK) { return; }
+    param = params->nrpn_map[nrpn & 0x7F];
+    if(param != PARAM_NONE) { params_set(params, param, channel, value); }
+}
+
+bool params_control_change(Params *params, uint8_t channel, uint8_t cc, uint8_t value) {
+    uint8_t param;
+
+    channel &= 0x0F;
+    cc &= 0x7F;
+    value &= 0x7F;
+
+    param = params->cc_map[cc];
+    if(param != PARAM_NONE) {
+        params_set(params, param, channel, (value << 7) | value);
+        return true;
+    }
+
+    switch(cc) {
+        case CC_NRPN_MSB: params->nrpn[channel] = (value << 7) | (params->nrpn[channel] & 0x7F); break;
+        case CC_NRPN_LSB: params->nrpn[channel] = (params->nrpn[channel] & 0x3F80) | value; break;
+        case CC_RPN_MSB:
+        case CC_RPN_LSB: params->nrpn[channel] = NRPN_NULL; break;
+        case CC_DATA_ENTRY:
+            // Coarse right away, a following LSB refines it
+            params->data_msb[channel] = value;
+            params_data_entry(params, channel, (value << 7) | value);
+            break;
+        case CC_DATA_ENTRY_LSB: params_data_entry(params, channel, (params->data_msb[channel] << 7) | value); break;
+        default: return false;
+    }
+    return true;
+}
+
+bool params_tick(Params *params) {
+    uint64_t moving = params->moving;
+    uint8_t slot;
+
+    if(moving == 0) { return false; }
+
+    for(slot = 0; moving != 0; slot++, moving >>= 1) {
+        if(!(moving & 1)) { continue; }
+
+        params->value[slot] = control_smooth(params->value[slot], params->target[slot],
+                                             params->defs[params->slot_param[slot]].smoothing);
+        if(params->value[slot] == params->target[slot]) { params->moving &= ~((uint64_t)1 << slot); }
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// Table driven controller to parameter map. CCs and NRPNs are looked up in
+// O(1), scaled through a curve into the parameter's range and smoothed
+// towards at control rate, so the audio path only sees small steps.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PARAM_NONE 0xFF
+
+// Parameters and value slots, a per channel parameter takes 16 slots
+#define PARAM_MAX 16
+#define PARAM_SLOTS 64
+
+// NRPN parameter numbers are PARAM_NRPN_BANK << 7 | ParamDef.nrpn
+#ifndef PARAM_NRPN_BANK
+#define PARAM_NRPN_BANK 1
+#endif
+
+// Largest 14-bit value, what 127 on a plain CC stands for
+#define PARAM_FULL 16383
+
+enum {
+    PARAM_LINEAR = 0,
+    // Audio taper for gains
+    PARAM_SQUARE,
+};
+
+// ParamDef.flags
+#define PARAM_PER_CHANNEL (1 << 0)
+
+typedef struct ParamDef {
+    // PARAM_NONE if not on a CC or NRPN
+    uint8_t cc;
+    uint8_t nrpn;
+    uint8_t curve;
+    uint8_t flags;
+    // One-pole time constant of 2^smoothing control ticks, 0 jumps
+    uint8_t smoothing;
+    // 14-bit controller value at startup
+    uint16_t initial;
+    int32_t min;
+    int32_t max;
+} ParamDef;
+
+typedef struct Params {
+    const ParamDef *defs;
+    uint8_t count;
+
+    uint8_t cc_map[128];
+    uint8_t nrpn_map[128];
+    // First value slot of every parameter and the other way round
+    uint8_t slot[PARAM_MAX];
+    uint8_t slot_param[PARAM_SLOTS];
+
+    int32_t target[PARAM_SLOTS];
+    int32_t value[PARAM_SLOTS];
+    // Slots that haven't reached their target yet
+    uint64_t moving;
+
+    // Selected NRPN number and data entry MSB per channel
+    uint16_t nrpn[16];
+    uint8_t data_msb[16];
+} Params;
+
+// defs has to outlive params
+void params_init(Params *params, const ParamDef *defs, uint8_t count);
+
+// Mapped CCs and NRPN selection / data entry, returns false for anything else
+bool params_control_change(Params *params, uint8_t channel, uint8_t cc, uint8_t value);
+
+// Set from a 14-bit controller value
+void params_set(Params *params, uint8_t param, uint8_t channel, uint16_t value);
+
+// Move every value one control tick towards its target, returns true if any changed
+bool params_tick(Params *params);
+
+static inline int32_t params_get(const Params *params, uint8_t param, uint8_t channel) {
+    uint8_t slot = params->slot[param];
+    if(params->defs[param].flags & PARAM_PER_CHANNEL) { slot += channel & 0x0F; }
+    return params->value[slot];
+}
@@ -1,7 +1,13 @@
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/i2c.h>
+#include <libopencm3/stm32/rcc.h>
+
 #include "ssd1306_128x32.h"
 
-#include "font8x8_basic.h"
-#include "tools.h"
+// Display the interrupts are sending for
+static struct SSD1306 *active;
 
 void SSD1306_send_data(struct SSD1306 *ssd1306, int spec, uint8_t data) {
     uint8_t bf[2];
@@ -10,62 +16,172 @@ void SSD1306_send_data(struct SSD1306 *ssd1306, int spec, uint8_t data) {
     i2c_transfer7(ssd1306->i2c, ssd1306->addr, bf, 2, NULL, 0);
 }
 
-void SSD1306_draw_pixel(struct SSD1306 *ssd1306, uint8_t x, uint8_t y) {
-    x &= 0b01111111;  // 128
-    y &= 0b00011111;  // 32
-    // y = HEIGHT - 1 - (y & 0b00011111);
-    ssd1306->screen_data[(x + (y >> 3) * ssd1306->width) & 0xFFF] |= 1 << (y & 0x07);
+// Queue the window commands and the data for one column/page rectangle.
+// In horizontal addressing the data wraps at col1 onto the next page.
+static uint8_t SSD1306_queue_rect(struct SSD1306 *ssd1306, uint8_t n, uint8_t col0, uint8_t col1, uint8_t page0,
+                                  uint8_t page1, const uint8_t *data) {
+    uint8_t *window = ssd1306->window[page0];
+    window[0] = SSD1306_SETCOLRANGE;
+    window[1] = col0;
+    window[2] = col1;
+    window[3] = SSD1306_SETPAGERANGE;
+    window[4] = page0;
+    window[5] = page1;
+    ssd1306->queue[n++] = (struct SSD1306Segment){SSD1306_CMD_START, sizeof(ssd1306->window[page0]), window};
+    ssd1306->queue[n++] = (struct SSD1306Segment){SSD1306_DATA_START, (col1 - col0 + 1) * (page1 - page0 + 1), data};
+    return n;
 }
 
-void SSD1306_draw_char(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, char ch) {
-    uint8_t i, j;
-    uint8_t selchar = ((int)ch) - 32;
-    for(i = 0; i < 8; i++) {
-        uint8_t line = font8x8_basic[selchar][i];
-        uint8_t y_seg = (y + i) & 0x07;
-        for(j = 0; j < 8; j++, line >>= 1) {
-            ssd1306->screen_data[((x + j) + ((y + i) >> 3) * ssd1306->width) & 0xFFF] |= (line & 1) << y_seg;
+// control byte and window commands, control byte before the data
+#define SSD1306_RECT_OVERHEAD (1 + 6 + 1)
+
+#if SSD1306_DOUBLE_BUFFER
+// Diff screen_data against the shadow, copy the changes over and queue them
+static uint8_t SSD1306_queue_changes(struct SSD1306 *ssd1306) {
+    // changed column span of each page, first is WIDTH when unchanged
+    uint8_t first[SSD1306_PAGES];
+    uint8_t last[SSD1306_PAGES];
+    int top = SSD1306_PAGES;
+    int bottom = -1;
+    uint16_t spans = 0;
+    for(int i = 0; i < SSD1306_PAGES; i++) {
+        const uint8_t *page = ssd1306->screen_data + i * WIDTH;
+        const uint8_t *shadow = ssd1306->shadow + i * WIDTH;
+        int f = 0;
+        int l = WIDTH - 1;
+        if(ssd1306->shadow_valid) {
+            while(f < WIDTH && page[f] == shadow[f]) { f++; }
+            if(f == WIDTH) {
+                first[i] = WIDTH;
+                continue;
+            }
+            while(page[l] == shadow[l]) { l--; }
         }
+        first[i] = f;
+        last[i] = l;
+        if(top > i) { top = i; }
+        bottom = i;
+        spans += SSD1306_RECT_OVERHEAD + l - f + 1;
     }
-}
 
-void SSD1306_draw_string(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, const char *str) {
-    while(*str) {
-        SSD1306_draw_char(ssd1306, x, y, *str++);
-        x += 8;
+    ssd1306->shadow_valid = 1;
+    if(bottom < 0) {
+        ssd1306->bytes_sent = 0;
+        return 0;
+    }
+
+    // Full width rows are contiguous: one burst when it is no more bytes than
+    // the separate spans, a full refresh is a single 512 byte stream.
+    uint8_t n = 0;
+    uint16_t burst = SSD1306_RECT_OVERHEAD + (bottom - top + 1) * WIDTH;
+    if(burst <= spans) {
+        uint8_t *rows = ssd1306->shadow + top * WIDTH;
+        memcpy(rows, ssd1306->screen_data + top * WIDTH, (bottom - top + 1) * WIDTH);
+        n = SSD1306_queue_rect(ssd1306, n, 0, WIDTH - 1, top, bottom, rows);
+        ssd1306->bytes_sent = burst;
+    } else {
+        for(int i = top; i <= bottom; i++) {
+            if(first[i] == WIDTH) { continue; }
+            uint8_t *span = ssd1306->shadow + i * WIDTH + first[i];
+            memcpy(span, ssd1306->screen_data + i * WIDTH + first[i], last[i] - first[i] + 1);
+            n = SSD1306_queue_rect(ssd1306, n, first[i], last[i], i, i, span);
+        }
+        ssd1306->bytes_sent = spans;
     }
+    return n;
 }
+#else
+// Nothing to diff against, the whole frame goes out from screen_data
+static uint8_t SSD1306_queue_changes(struct SSD1306 *ssd1306) {
+    ssd1306->shadow_valid = 1;
+    ssd1306->bytes_sent = SSD1306_RECT_OVERHEAD + WIDTH * SSD1306_PAGES;
+    return SSD1306_queue_rect(ssd1306, 0, 0, WIDTH - 1, 0, SSD1306_PAGES - 1, ssd1306->screen_data);
+}
+#endif
+
+bool SSD1306_refresh(struct SSD1306 *ssd1306) {
+    if(ssd1306->busy) { return false; }
+
+    uint8_t n = SSD1306_queue_changes(ssd1306);
+    if(n == 0) { return true; }
 
-void SSD1306_print_number(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, int32_t num) {
-    // max length => -32768
-    char buf[17];
-    itoa7(num, buf);
-    buf[16] = 0;
-    SSD1306_draw_string(ssd1306, x, y, buf);
+    ssd1306->segments = n;
+    ssd1306->segment = 0;
+    ssd1306->draining = 0;
+    ssd1306->busy = 1;
+    active = ssd1306;
+    i2c_enable_interrupt(ssd1306->i2c, I2C_CR2_ITEVTEN | I2C_CR2_ITERREN);
+    i2c_send_start(ssd1306->i2c);
+    return true;
 }
 
-void SSD1306_clear(struct SSD1306 *ssd1306, uint8_t val) {
-    memset(ssd1306->screen_data, val, ssd1306->screen_data_length);
+void SSD1306_set_done_callback(struct SSD1306 *ssd1306, void (*done)(void)) {
+    ssd1306->done = done;
 }
 
-void SSD1306_refresh(struct SSD1306 *ssd1306) {
-    uint8_t pbuffer[WIDTH + 1];
-    for(int i = 0; i < 8; i++) {
-        SSD1306_send_data(ssd1306, 0x00, 0xB0 + i);
-        SSD1306_send_data(ssd1306, 0x00, 0x00);
-        SSD1306_send_data(ssd1306, 0x00, 0x10);
-
-        uint8_t *buffer = ssd1306->screen_data + i * WIDTH + WIDTH - 1;
-        pbuffer[0] = 0x40;
-        for(int j = 0; j < WIDTH; j++) {
-            pbuffer[j + 1] = *buffer;
-            buffer--;
-        }
+void SSD1306_invalidate(struct SSD1306 *ssd1306) {
+    ssd1306->shadow_valid = 0;
+}
 
-        i2c_transfer7(ssd1306->i2c, ssd1306->addr, pbuffer, WIDTH + 1, NULL, 0);
+static void SSD1306_finish(struct SSD1306 *ssd1306) {
+    i2c_send_stop(ssd1306->i2c);
+    i2c_disable_interrupt(ssd1306->i2c, I2C_CR2_ITEVTEN | I2C_CR2_ITERREN);
+    ssd1306->draining = 0;
+    ssd1306->busy = 0;
+    if(ssd1306->done) { ssd1306->done(); }
+}
+
+void i2c1_ev_isr(void) {
+    struct SSD1306 *ssd1306 = active;
+    uint32_t sr1 = I2C_SR1(ssd1306->i2c);
+
+    if(sr1 & I2C_SR1_SB) {
+        i2c_send_7bit_address(ssd1306->i2c, ssd1306->addr, I2C_WRITE);
+    } else if(sr1 & I2C_SR1_ADDR) {
+        // reading SR2 after SR1 clears ADDR
+        (void)I2C_SR2(ssd1306->i2c);
+        const struct SSD1306Segment *seg = &ssd1306->queue[ssd1306->segment];
+        i2c_send_data(ssd1306->i2c, seg->control);
+
+        // no events wanted until DMA has handed over the last byte
+        i2c_disable_interrupt(ssd1306->i2c, I2C_CR2_ITEVTEN);
+        dma_set_memory_address(DMA1, SSD1306_DMA_CHANNEL, (uint32_t)seg->data);
+        dma_set_number_of_data(DMA1, SSD1306_DMA_CHANNEL, seg->len);
+        i2c_enable_dma(ssd1306->i2c);
+        dma_enable_channel(DMA1, SSD1306_DMA_CHANNEL);
+    } else if((sr1 & I2C_SR1_BTF) && ssd1306->draining) {
+        // last byte is on the wire. BTF only clears once the (re)start or stop
+        // condition is out, draining keeps the repeat interrupts from acting twice.
+        ssd1306->draining = 0;
+        if(++ssd1306->segment < ssd1306->segments) {
+            i2c_send_start(ssd1306->i2c);
+        } else {
+            SSD1306_finish(ssd1306);
+        }
     }
 }
 
+void dma1_channel6_isr(void) {
+    dma_clear_interrupt_flags(DMA1, SSD1306_DMA_CHANNEL, DMA_TCIF);
+    dma_disable_channel(DMA1, SSD1306_DMA_CHANNEL);
+    i2c_disable_dma(active->i2c);
+
+    // wait for BTF before the stop or the next segment
+    active->draining = 1;
+    i2c_enable_interrupt(active->i2c, I2C_CR2_ITEVTEN);
+}
+
+void i2c1_er_isr(void) {
+    struct SSD1306 *ssd1306 = active;
+    // NACK, bus error or lost arbitration: drop the frame, the next refresh resends everything
+    I2C_SR1(ssd1306->i2c) &= ~(I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR);
+    dma_disable_channel(DMA1, SSD1306_DMA_CHANNEL);
+    i2c_disable_dma(ssd1306->i2c);
+    ssd1306->errors++;
+    ssd1306->shadow_valid = 0;
+    SSD1306_finish(ssd1306);
+}
+
 void SSD1306_init(struct SSD1306 *ssd1306, uint32_t i2c_addr) {
     ssd1306->i2c = i2c_addr;
     ssd1306->addr = 0x3C;
@@ -73,6 +189,11 @@ void SSD1306_init(struct SSD1306 *ssd1306, uint32_t i2c_addr) {
     ssd1306->height = HEIGHT;
 
     ssd1306->screen_data_length = ssd1306->width * ssd1306->height >> 3;
+    ssd1306->shadow_valid = 0;
+    ssd1306->bytes_sent = 0;
+    ssd1306->busy = 0;
+    ssd1306->errors = 0;
+    ssd1306->done = NULL;
     // TODO: is using malloc here reasonable?
     //       it eats 600 bytes from the firmware
     // ssd1306->screen_data = (uint8_t *)malloc(ssd1306->screen_data_length);
@@ -92,7 +213,8 @@ void SSD1306_init(struct SSD1306 *ssd1306, uint32_t i2c_addr) {
         0x14,
         SSD1306_SETADDRESSMODE,
         0x00,
-        SSD1306_COLSCAN_DESCENDING,
+        // framebuffer column x is panel column x, refresh streams it as is
+        SSD1306_COLSCAN_ASCENDING,
         SSD1306_COMSCAN_ASCENDING,
         SSD1306_SETCOMPINS,
         0x02,
@@ -135,4 +257,24 @@ void SSD1306_i2c_setup(void) {
 
     /* And go */
     i2c_peripheral_enable(I2C1);
+
+    /* DMA1 channel 6 (I2C1_TX) streams refresh data, addresses are set per segment */
+    rcc_periph_clock_enable(RCC_DMA1);
+    dma_channel_reset(DMA1, SSD1306_DMA_CHANNEL);
+    dma_set_peripheral_address(DMA1, SSD1306_DMA_CHANNEL, (uint32_t)&I2C_DR(I2C1));
+    dma_set_read_from_memory(DMA1, SSD1306_DMA_CHANNEL);
+    dma_enable_memory_increment_mode(DMA1, SSD1306_DMA_CHANNEL);
+    dma_set_peripheral_size(DMA1, SSD1306_DMA_CHANNEL, DMA_CCR_PSIZE_8BIT);
+    dma_set_memory_size(DMA1, SSD1306_DMA_CHANNEL, DMA_CCR_MSIZE_8BIT);
+    dma_set_priority(DMA1, SSD1306_DMA_CHANNEL, DMA_CCR_PL_LOW);
+    dma_enable_transfer_complete_interrupt(DMA1, SSD1306_DMA_CHANNEL);
+
+    /* SSD1306_init still writes its commands blocking, the interrupts are
+       only switched on in I2C_CR2 while a refresh is out */
+    nvic_set_priority(NVIC_DMA1_CHANNEL6_IRQ, SSD1306_IRQ_PRIORITY);
+    nvic_set_priority(NVIC_I2C1_EV_IRQ, SSD1306_IRQ_PRIORITY);
+    nvic_set_priority(NVIC_I2C1_ER_IRQ, SSD1306_IRQ_PRIORITY);
+    nvic_enable_irq(NVIC_DMA1_CHANNEL6_IRQ);
+    nvic_enable_irq(NVIC_I2C1_EV_IRQ);
+    nvic_enable_irq(NVIC_I2C1_ER_IRQ);
 }
@@ -1,6 +1,4 @@
-#include <libopencm3/stm32/i2c.h>
-#include <libopencm3/stm32/rcc.h>
-#include <libopencm3/stm32/gpio.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,6 +12,20 @@
 #define SSD1306_PAGE_STOP ((WIDTH / 8) - 1)
 #define SSD1306_COL_START 0
 #define SSD1306_COL_STOP (HEIGHT - 1)
+#define SSD1306_PAGES (HEIGHT / 8)
+
+// I2C1_TX request line
+#define SSD1306_DMA_CHANNEL DMA_CHANNEL6
+// Below the audio and MIDI interrupts, a late display byte costs nothing
+#define SSD1306_IRQ_PRIORITY (3 << 4)
+
+// 1 keeps a second 512 byte buffer with what the panel shows: refresh sends
+// only the changes and DMA streams from it, so the next frame can be drawn
+// meanwhile. 0 saves the RAM, every refresh streams the whole frame straight
+// from screen_data and SSD1306_wait has to be called before drawing.
+#ifndef SSD1306_DOUBLE_BUFFER
+#define SSD1306_DOUBLE_BUFFER 1
+#endif
 // SSD1306 Commands - see Datasheet
 #define SSD1306_CMD_START 0x00   // indicates following bytes are commands
 #define SSD1306_DATA_START 0x40  // indicates following bytes are data
@@ -57,18 +69,42 @@
 // Charge Pump Commands (p. 62)
 #define SSD1306_SETCHARGEPUMP 0x8D  // enable / disable charge pump
 
+// One I2C write: the control byte from the CPU, then len bytes by DMA
+struct SSD1306Segment {
+    uint8_t control;
+    uint16_t len;
+    const uint8_t *data;
+};
+
 struct SSD1306 {
     uint32_t i2c;
     uint8_t addr;
     uint8_t width;
     uint8_t height;
     uint16_t screen_data_length;
-    // TODO: Why does /8 cause crash here?
-    uint8_t screen_data[WIDTH * HEIGHT / 4];
+    uint8_t screen_data[WIDTH * HEIGHT / 8];
+#if SSD1306_DOUBLE_BUFFER
+    // what the panel shows once the last refresh is out
+    uint8_t shadow[WIDTH * SSD1306_PAGES];
+#endif
+    uint8_t shadow_valid;
+    // I2C bytes sent by the last refresh, commands included
+    uint16_t bytes_sent;
+
+    // transfer in progress, owned by the interrupts while busy is set
+    uint8_t window[SSD1306_PAGES][6];
+    struct SSD1306Segment queue[SSD1306_PAGES * 2];
+    uint8_t segments;
+    volatile uint8_t segment;
+    volatile uint8_t draining;
+    volatile uint8_t busy;
+    volatile uint16_t errors;
+    void (*done)(void);
 };
 
 void SSD1306_send_data(struct SSD1306 *ssd1306, int spec, uint8_t data);
 
+// Drawing into screen_data, in ssd1306_draw.c, needs no hardware
 void SSD1306_draw_pixel(struct SSD1306 *ssd1306, uint8_t x, uint8_t y);
 
 void SSD1306_draw_char(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, char ch);
@@ -79,7 +115,28 @@ void SSD1306_print_number(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, int32_t
 
 void SSD1306_clear(struct SSD1306 *ssd1306, uint8_t val);
 
-void SSD1306_refresh(struct SSD1306 *ssd1306);
+// Start sending what changed since the last refresh and return at once.
+// Returns false without doing anything while the previous one is still out,
+// the changes are picked up by the next call.
+bool SSD1306_refresh(struct SSD1306 *ssd1306);
+
+static inline bool SSD1306_busy(const struct SSD1306 *ssd1306) {
+    return ssd1306->busy;
+}
+
+// Until screen_data may be drawn into, only waits without the double buffer
+static inline void SSD1306_wait(const struct SSD1306 *ssd1306) {
+#if !SSD1306_DOUBLE_BUFFER
+    while(ssd1306->busy) {}
+#endif
+    (void)ssd1306;
+}
+
+// called from the interrupt when a refresh has been sent
+void SSD1306_set_done_callback(struct SSD1306 *ssd1306, void (*done)(void));
+
+// forget the shadow so the next refresh rewrites the whole panel
+void SSD1306_invalidate(struct SSD1306 *ssd1306);
 
 void SSD1306_init(struct SSD1306 *ssd1306, uint32_t i2c_addr);
 
@@ -0,0 +1,50 @@
+#include "ssd1306_128x32.h"
+
+#include "font8x8_basic.h"
+#include "tools.h"
+
+void SSD1306_draw_pixel(struct SSD1306 *ssd1306, uint8_t x, uint8_t y) {
+    if(x >= WIDTH || y >= HEIGHT) { return; }
+    ssd1306->screen_data[x + (y >> 3) * WIDTH] |= 1 << (y & 0x07);
+}
+
+void SSD1306_draw_char(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, char ch) {
+    uint8_t glyph = (uint8_t)ch - 32;
+    if(glyph >= 96 || x >= WIDTH || y >= HEIGHT) { return; }
+
+    const uint8_t *cols = font8x8_basic[glyph];
+    uint8_t n = WIDTH - x < 8 ? WIDTH - x : 8;
+    uint8_t *top = ssd1306->screen_data + (y >> 3) * WIDTH + x;
+    uint8_t shift = y & 0x07;
+
+    if(shift == 0) {
+        for(uint8_t i = 0; i < n; i++) { top[i] |= cols[i]; }
+        return;
+    }
+
+    // straddles two pages, the lower part is clipped on the last one
+    for(uint8_t i = 0; i < n; i++) { top[i] |= cols[i] << shift; }
+    if((y >> 3) + 1 < SSD1306_PAGES) {
+        uint8_t *bottom = top + WIDTH;
+        for(uint8_t i = 0; i < n; i++) { bottom[i] |= cols[i] >> (8 - shift); }
+    }
+}
+
+void SSD1306_draw_string(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, const char *str) {
+    while(*str && x < WIDTH) {
+        SSD1306_draw_char(ssd1306, x, y, *str++);
+        x += 8;
+    }
+}
+
+void SSD1306_print_number(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, int32_t num) {
+    // max length => -32768
+    char buf[17];
+    itoa7(num, buf);
+    buf[16] = 0;
+    SSD1306_draw_string(ssd1306, x, y, buf);
+}
+
+void SSD1306_clear(struct SSD1306 *ssd1306, uint8_t val) {
+    memset(ssd1306->screen_data, val, ssd1306->screen_data_length);
+}
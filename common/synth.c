@@ -0,0 +1,492 @@
+#include "synth.h"
+
+#include <string.h>
+
+#include "control.h"
+#include "dsp.h"
+#include "midi_clock.h"
+#include "midi_queue.h"
+#include "mixer.h"
+#include "oscillator.h"
+#include "params.h"
+#include "tools.h"
+
+// Phase increment per MIDI note with no detune: 440 * fixed_exp2(((note - 69) << 16) / 12)
+static const uint32_t note_increments[128] = {
+    535480, 567600, 601040, 637120, 674960, 715000, 757680, 802560,
+    850080, 900680, 954360, 1011120, 1071400, 1135200, 1202520, 1274240,
+    1349920, 1430440, 1515360, 1605560, 1700600, 1801800, 1909160, 2022680,
+    2143240, 2270840, 2405480, 2548480, 2700280, 2860880, 3030720, 3211120,
+    3401640, 3604040, 3818320, 4045800, 4286480, 4541680, 4811400, 5096960,
+    5401000, 5721760, 6061880, 6422240, 6803720, 7208080, 7637080, 8091600,
+    8573400, 9083360, 9623240, 10193920, 10802000, 11443960, 12124200, 12844480,
+    13607880, 14416600, 15274600, 16183640, 17146800, 18166720, 19246480, 20388280,
+    21604000, 22888360, 24248400, 25688960, 27215760, 28833640, 30549200, 32366840,
+    34293600, 36333440, 38492520, 40777000, 43207560, 45776720, 48497240, 51377920,
+    54431080, 57667720, 61098400, 64734120, 68587200, 72667320, 76985480, 81554440,
+    86415560, 91553880, 96994920, 102755840, 108862160, 115335880, 122196800, 129468680,
+    137174840, 145335080, 153971400, 163108880, 172831560, 183107760, 193989840, 205512120,
+    217724320, 230671760, 244394040, 258937800, 274349680, 290670160, 307942800, 326217760,
+    345663120, 366215960, 387979680, 411024680, 435448640, 461343520, 488788520, 517876040,
+    548699360, 581340760, 615885600, 652435960, 691326680, 732432360, 775959800, 822049800
+};
+
+static Voices voices;
+static Envelope envelope;
+static Lfo lfo;
+static MidiClock midi_clock;
+
+// Published at control rate for the main loop
+static volatile uint32_t tempo = 0;
+static volatile uint32_t beat_position = 0;
+
+// MIDI input, drained by the audio interrupt
+static MidiQueue midi_queue;
+
+static volatile uint8_t waveform = OSC_SAW;
+
+// Controller driven parameters, indexed by the SYNTH_PARAM_ enum
+static const ParamDef param_defs[SYNTH_PARAMS] = {
+    [SYNTH_PARAM_VOLUME] = {7, SYNTH_PARAM_VOLUME, PARAM_SQUARE, PARAM_PER_CHANNEL, 4, PARAM_FULL, 0, 32767},
+    [SYNTH_PARAM_EXPRESSION] = {11, SYNTH_PARAM_EXPRESSION, PARAM_SQUARE, PARAM_PER_CHANNEL, 4, PARAM_FULL, 0, 32767},
+    [SYNTH_PARAM_VIBRATO] = {LFO_CC_DEPTH, SYNTH_PARAM_VIBRATO, PARAM_LINEAR, 0, 3, 0, 0, 127},
+    [SYNTH_PARAM_LFO_RATE] = {LFO_CC_RATE, SYNTH_PARAM_LFO_RATE, PARAM_LINEAR, 0, 0, 80 * 129, 0, 127},
+    [SYNTH_PARAM_ATTACK] = {ENV_CC_ATTACK, SYNTH_PARAM_ATTACK, PARAM_LINEAR, 0, 0, 0, 0, 127},
+    [SYNTH_PARAM_DECAY] = {ENV_CC_DECAY, SYNTH_PARAM_DECAY, PARAM_LINEAR, 0, 0, 99 * 129, 0, 127},
+    [SYNTH_PARAM_SUSTAIN] = {ENV_CC_SUSTAIN, SYNTH_PARAM_SUSTAIN, PARAM_LINEAR, 0, 4, 0, 0, ENV_ONE},
+    [SYNTH_PARAM_RELEASE] = {ENV_CC_RELEASE, SYNTH_PARAM_RELEASE, PARAM_LINEAR, 0, 0, 70 * 129, 0, 127},
+    [SYNTH_PARAM_LFO_SYNC] = {80, SYNTH_PARAM_LFO_SYNC, PARAM_LINEAR, 0, 0, 0, 0, 127},
+};
+
+static Params params;
+
+// Volume times expression per MIDI channel, Q15
+static int32_t channel_gain[16];
+
+// Rate the LFO was last set to, lfo_set_rate isn't free
+static uint8_t lfo_rate;
+
+// Written from the main loop and MIDI, read at control rate.
+// All of them are in s15.16 semitones.
+static volatile int32_t knob_target = 0;
+static volatile int32_t bend_detune[16];
+
+// Smoothed copy of knob_target
+static int32_t knob_detune = 0;
+
+// Channel independent part of the detune, as of the last control tick
+static int32_t detune = 0;
+
+// Detune each voice's increment was last computed with, including the channel bend
+static int32_t voice_detune[SYNTH_VOICES];
+
+// Vibrato depth from the mod wheel and from channel pressure, the deeper one wins
+static uint8_t mod_depth = 0;
+static uint8_t pressure_depth = 0;
+
+// Frames left until the next control tick
+static uint32_t control_countdown = 0;
+
+// Voices whose stage changed between control ticks, their ramps get redone at the event frame
+static uint16_t retick_voices = 0;
+
+// Frame number of the next frame to render, on the same clock as the event stamps
+static volatile uint32_t render_frame = 0;
+
+// Time source for event stamps and the latency added on top, see synth_set_clock
+static synth_clock_cb event_clock;
+static uint32_t event_latency = 0;
+
+// Cycle counter for the latency statistics, see synth_set_cycle_counter
+static synth_clock_cb cycle_counter;
+static uint32_t cycles_per_frame = 0;
+static volatile uint32_t latency_last = 0;
+static volatile uint32_t latency_max = 0;
+static volatile uint32_t latency_average = 0;
+
+static volatile uint32_t clip_count = 0;
+
+// Render cycles per voice and control period, measured by synth_calibrate_voices
+static uint32_t voice_cycles = 0;
+
+static uint32_t note_increment(int16_t note, int32_t note_detune) {
+    if(note_detune == 0) { return note_increments[note + 69]; }
+    return 440 * fixed_exp2((note * 65536 + note_detune) / 12);
+}
+
+static void synth_update_increment(uint8_t i) {
+    voice_detune[i] = detune + bend_detune[voices.channel[i]];
+    voices.increment[i] = note_increment(voices.note[i], voice_detune[i]);
+    voices.increment_step[i] = 0;
+}
+
+static void synth_update_vibrato(void) { lfo.depth = mod_depth > pressure_depth ? mod_depth : pressure_depth; }
+
+// Pull the smoothed parameter values into the envelope, LFO and channel gains
+static void synth_apply_params(void) {
+    int i;
+
+    for(i = 0; i < 16; i++) {
+        channel_gain[i] = (params_get(&params, SYNTH_PARAM_VOLUME, i) *
+                           params_get(&params, SYNTH_PARAM_EXPRESSION, i)) >> 15;
+    }
+
+    mod_depth = params_get(&params, SYNTH_PARAM_VIBRATO, 0);
+    synth_update_vibrato();
+
+    if(params_get(&params, SYNTH_PARAM_LFO_RATE, 0) != lfo_rate) {
+        lfo_rate = params_get(&params, SYNTH_PARAM_LFO_RATE, 0);
+        lfo_set_rate(&lfo, lfo_rate);
+    }
+
+    envelope_set_attack(&envelope, params_get(&params, SYNTH_PARAM_ATTACK, 0));
+    envelope_set_decay(&envelope, params_get(&params, SYNTH_PARAM_DECAY, 0));
+    envelope_set_release(&envelope, params_get(&params, SYNTH_PARAM_RELEASE, 0));
+    envelope.sustain = params_get(&params, SYNTH_PARAM_SUSTAIN, 0);
+}
+
+void synth_init(void) {
+    int i;
+
+    // Back to power-on, the clock and cycle counter settings are kept
+    memset(&voices, 0, sizeof(voices));
+    memset((void *)bend_detune, 0, sizeof(bend_detune));
+    knob_target = 0;
+    knob_detune = 0;
+    detune = 0;
+    mod_depth = 0;
+    pressure_depth = 0;
+    waveform = OSC_SAW;
+    tempo = 0;
+    beat_position = 0;
+    control_countdown = 0;
+    retick_voices = 0;
+    render_frame = 0;
+    latency_last = 0;
+    latency_max = 0;
+    latency_average = 0;
+    clip_count = 0;
+
+    midi_queue_init(&midi_queue);
+    envelope_init(&envelope);
+    lfo_init(&lfo);
+    midi_clock_init(&midi_clock);
+    params_init(&params, param_defs, SYNTH_PARAMS);
+    lfo_rate = params_get(&params, SYNTH_PARAM_LFO_RATE, 0);
+    synth_apply_params();
+    for(i = 0; i < SYNTH_VOICES; i++) { synth_update_increment(i); }
+    voices.limit = SYNTH_VOICES;
+}
+
+void synth_note_on(uint8_t channel, uint8_t note, uint8_t velocity) {
+    uint8_t i;
+
+    if(velocity == 0) {
+        synth_note_off(channel, note);
+        return;
+    }
+    i = voice_note_on(&voices, channel, note, velocity);
+    synth_update_increment(i);
+    retick_voices |= 1 << i;
+}
+
+void synth_note_off(uint8_t channel, uint8_t note) { retick_voices |= voice_note_off(&voices, channel, note); }
+
+void synth_sustain(bool down) { retick_voices |= voice_sustain(&voices, down); }
+
+void synth_all_notes_off(void) { retick_voices |= voice_all_off(&voices); }
+
+void synth_control_change(uint8_t channel, uint8_t cc, uint8_t value) {
+    if(params_control_change(&params, channel, cc, value)) { return; }
+
+    switch(cc) {
+        case 64: synth_sustain(value >= 64); break;
+        case 123: synth_all_notes_off(); break;
+        default: break;
+    }
+}
+
+uint8_t synth_active_voices(void) { return voice_active_count(&voices); }
+
+void synth_set_knob(int32_t value) { knob_target = value * 16; }
+
+void synth_set_pitch_bend(uint8_t channel, uint16_t value) {
+    // +-2 semitones, 8192 is the center
+    bend_detune[channel & 0x0F] = ((int32_t)value - 8192) * 16;
+}
+
+void synth_channel_pressure(uint8_t channel, uint8_t value) {
+    (void)channel;
+    pressure_depth = value & 0x7F;
+    synth_update_vibrato();
+}
+
+void synth_set_waveform(uint8_t value) {
+    if(value < OSC_WAVEFORMS) { waveform = value; }
+}
+
+uint32_t synth_clip_count(void) { return clip_count; }
+
+uint32_t synth_tempo(void) { return tempo; }
+
+uint32_t synth_beat_position(void) { return beat_position; }
+
+// Program change selects the waveform
+static void synth_program_change(uint8_t channel, uint8_t program) {
+    (void)channel;
+    synth_set_waveform(program);
+}
+
+// Clock ticks are stamped with the frame they take effect at, which is now
+static void synth_system(uint8_t status, uint8_t data1, uint8_t data2) {
+    switch(status) {
+        case 0xF2: midi_clock_song_position(&midi_clock, data1 | (data2 << 7)); break;
+        case 0xF8: midi_clock_tick(&midi_clock, render_frame); break;
+        case 0xFA: midi_clock_start(&midi_clock); break;
+        case 0xFB: midi_clock_continue(&midi_clock); break;
+        case 0xFC: midi_clock_stop(&midi_clock); break;
+        default: break;
+    }
+}
+
+static const MidiHandlers synth_midi_handlers = {
+    .note_on = synth_note_on,
+    .note_off = synth_note_off,
+    .control_change = synth_control_change,
+    .program_change = synth_program_change,
+    .channel_pressure = synth_channel_pressure,
+    .pitch_bend = synth_set_pitch_bend,
+    .system = synth_system,
+};
+
+void synth_set_clock(synth_clock_cb clock, uint32_t latency) {
+    event_clock = clock;
+    event_latency = latency;
+}
+
+void synth_set_cycle_counter(synth_clock_cb counter, uint32_t cycles) {
+    cycle_counter = counter;
+    cycles_per_frame = cycles;
+}
+
+void synth_queue_event(const MidiEvent *event) {
+    MidiEvent stamped = *event;
+
+    if(cycle_counter) { stamped.arrival = cycle_counter(); }
+
+    // Without a clock events are due right away and apply at the start of the next block
+    stamped.time = event_clock ? event_clock() + event_latency : render_frame;
+    midi_queue_push(&midi_queue, &stamped);
+}
+
+void synth_get_stats(SynthStats *stats) {
+    stats->overflows = midi_queue.overflows;
+    stats->max_depth = midi_queue.max_depth;
+    stats->latency_last = latency_last;
+    stats->latency_max = latency_max;
+    stats->latency_average = latency_average;
+    stats->voice_limit = voices.limit;
+    stats->voice_cycles = voice_cycles;
+}
+
+// Cycles from arrival until the event's frame leaves the DAC, which is still (frame - clock()) frames away.
+// A late event plays at render_frame rather than its stamp, that is the frame it is heard at.
+static void synth_measure_latency(const MidiEvent *event) {
+    uint32_t latency = cycle_counter() - event->arrival;
+    uint32_t frame = (int32_t)(event->time - render_frame) > 0 ? event->time : render_frame;
+
+    latency += (int32_t)(frame - event_clock()) * (int32_t)cycles_per_frame;
+    latency_last = latency;
+    if(latency > latency_max) { latency_max = latency; }
+    latency_average += ((int32_t)latency - (int32_t)latency_average) / 16;
+}
+
+// Ramp the gain of voice i to its envelope level over the next frames
+static void synth_voice_ramp(uint8_t i, uint32_t frames) {
+    int32_t target;
+
+    target = (voices.level[i] >> 6) / 127 * voices.velocity[i];
+    target = ((int64_t)target * channel_gain[voices.channel[i]]) >> 15;
+    voices.gain_step[i] = (target - voices.gain[i]) / (int32_t)frames;
+
+    // The division truncates, a remainder smaller than one step per frame would never clear
+    // and keep an idle voice rendering. It is far below the 11 bits the mix drops.
+    if(voices.gain_step[i] == 0) { voices.gain[i] = target; }
+}
+
+// Evaluate the modulation sources and publish per frame ramps for the next CONTROL_PERIOD frames
+static void synth_control_tick(void) {
+    int32_t target;
+    int32_t d;
+    int i;
+
+    retick_voices = 0;
+
+    // Controllers glide at control rate, the gain ramps below take it down to the frame
+    if(params_tick(&params)) { synth_apply_params(); }
+
+    // Knob moves in steps at the display frame rate, smooth it over ~10ms
+    knob_detune = control_smooth(knob_detune, knob_target, 4);
+
+    // Vibrato, up to +-1 semitone
+    beat_position = midi_clock_position(&midi_clock, render_frame);
+    tempo = midi_clock_tempo(&midi_clock, SYNTH_SAMPLE_RATE);
+
+    // Synced, the LFO phase follows the beat, lfo_tick adds one increment on top
+    if(params_get(&params, SYNTH_PARAM_LFO_SYNC, 0) >= 64 && midi_clock.running && midi_clock_locked(&midi_clock)) {
+        lfo.phase = (beat_position << 16) - lfo.increment;
+    }
+
+    detune = knob_detune + lfo_tick(&lfo) * 2;
+
+    for(i = 0; i < SYNTH_VOICES; i++) {
+        voices.start_level[i] = voices.level[i];
+        if(voices.stage[i] == ENV_IDLE && voices.gain[i] == 0) {
+            voices.gain_step[i] = 0;
+            continue;
+        }
+
+        voices.level[i] = envelope_tick(&envelope, &voices.stage[i], voices.level[i]);
+        synth_voice_ramp(i, CONTROL_PERIOD);
+
+        voices.increment_step[i] = 0;
+        d = detune + bend_detune[voices.channel[i]];
+        if(d != voice_detune[i]) {
+            voice_detune[i] = d;
+            target = note_increment(voices.note[i], d);
+            voices.increment_step[i] = (target - (int32_t)voices.increment[i]) / CONTROL_PERIOD;
+        }
+    }
+}
+
+// Add one voice into the mix buffer, gain and pitch ramp towards the values of the next tick
+static void synth_render_voice(uint8_t i, uint8_t wave, int32_t *mix, uint32_t frames) {
+    uint32_t phase = voices.phase[i];
+    uint32_t increment = voices.increment[i];
+    int32_t increment_step = voices.increment_step[i];
+    int32_t gain = voices.gain[i];
+    int32_t gain_step = voices.gain_step[i];
+
+    while(frames--) {
+        gain += gain_step;
+        increment += increment_step;
+        phase += increment;
+        *mix++ += dsp_smulwb(gain >> 11, osc_sample(wave, phase, increment));
+    }
+
+    voices.phase[i] = phase;
+    voices.increment[i] = increment;
+    voices.gain[i] = gain;
+}
+
+static void synth_render_block(uint16_t *out, uint32_t frames) {
+    int32_t mix[CONTROL_PERIOD] = {0};
+    uint8_t wave = waveform;
+    int i;
+
+    for(i = 0; i < SYNTH_VOICES; i++) {
+        if(voices.gain[i] == 0 && voices.gain_step[i] == 0) { continue; }
+        synth_render_voice(i, wave, mix, frames);
+    }
+
+    // Soft clip into uint16 output values, counting the limited samples for the distortion alert
+    clip_count += mixer_output(out, mix, frames);
+}
+
+// Dispatch the events that are due at render_frame, returns the frames until the next one
+static uint32_t synth_apply_events(void) {
+    const MidiEvent *next;
+    MidiEvent event;
+    int32_t wait;
+
+    while((next = midi_queue_peek(&midi_queue)) != NULL) {
+        // Late events (wait < 0) apply right away
+        wait = (int32_t)(next->time - render_frame);
+        if(wait > 0) { return wait; }
+        midi_queue_pop(&midi_queue, &event);
+        if(cycle_counter && event_clock) { synth_measure_latency(&event); }
+        midi_dispatch(&event, &synth_midi_handlers);
+    }
+
+    return UINT32_MAX;
+}
+
+void synth_render(uint16_t *out, uint32_t frames) {
+    while(frames > 0) {
+        uint32_t block;
+        uint32_t next_event;
+        int i;
+
+        next_event = synth_apply_events();
+
+        if(control_countdown == 0) {
+            synth_control_tick();
+            control_countdown = CONTROL_PERIOD;
+        }
+
+        // Notes started or released by the events ramp from this frame on, not from the next tick.
+        // The envelope step of this period is redone in the new stage, it doesn't take another one.
+        for(i = 0; retick_voices != 0; i++, retick_voices >>= 1) {
+            if(retick_voices & 1) {
+                voices.level[i] = envelope_tick(&envelope, &voices.stage[i], voices.start_level[i]);
+                synth_voice_ramp(i, control_countdown);
+            }
+        }
+
+        // Never render across a control tick or an event
+        block = frames < control_countdown ? frames : control_countdown;
+        if(next_event < block) { block = next_event; }
+        synth_render_block(out, block);
+        out += block * 2;
+        frames -= block;
+        control_countdown -= block;
+        render_frame += block;
+    }
+}
+
+uint8_t synth_calibrate_voices(synth_clock_cb counter, uint32_t budget) {
+    uint16_t out[CONTROL_PERIOD * 2];
+    uint32_t frame = render_frame;
+    uint32_t clips = clip_count;
+    uint8_t wave = waveform;
+    uint32_t start, cost, base, full = 0, limit;
+    uint8_t i;
+
+    // Line up with the control ticks, so every timed render includes one
+    synth_render(out, control_countdown);
+
+    start = counter();
+    synth_render(out, CONTROL_PERIOD);
+    base = counter() - start;
+
+    voices.limit = SYNTH_VOICES;
+    for(i = 0; i < SYNTH_VOICES; i++) { synth_note_on(0, 36 + i, 127); }
+    for(i = 0; i < OSC_WAVEFORMS; i++) {
+        waveform = i;
+        start = counter();
+        synth_render(out, CONTROL_PERIOD);
+        cost = counter() - start;
+        if(cost > full) { full = cost; }
+    }
+
+    voice_cycles = full > base ? (full - base + SYNTH_VOICES - 1) / SYNTH_VOICES : 1;
+    limit = budget > base ? (budget - base) / voice_cycles : 0;
+    voices.limit = limit < 1 ? 1 : limit > SYNTH_VOICES ? SYNTH_VOICES : limit;
+
+    // Silence straight away rather than through the release
+    for(i = 0; i < SYNTH_VOICES; i++) {
+        voices.stage[i] = ENV_IDLE;
+        voices.gate[i] = false;
+        voices.sustained[i] = false;
+        voices.level[i] = 0;
+        voices.start_level[i] = 0;
+        voices.gain[i] = 0;
+        voices.gain_step[i] = 0;
+    }
+    retick_voices = 0;
+    render_frame = frame;
+    clip_count = clips;
+    waveform = wave;
+
+    return voices.limit;
+}
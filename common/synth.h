@@ -0,0 +1,110 @@
+#pragma once
+
+// Hardware independent synth engine. Renders blocks of interleaved
+// right/left frames in the unsigned 16-bit format the DAC expects.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "control.h"
+#include "midi_parser.h"
+#include "voices.h"
+
+#define SYNTH_SAMPLE_RATE CONTROL_SAMPLE_RATE
+
+void synth_init(void);
+
+// Current output frame number, e.g. i2s_frame_position
+typedef uint32_t (*synth_clock_cb)(void);
+
+// Events get stamped with clock() + latency on arrival and take effect at
+// exactly that frame. The latency has to cover the time until that frame is
+// rendered, then every event gets the same delay. Without a clock events
+// apply at the start of the next rendered block.
+void synth_set_clock(synth_clock_cb clock, uint32_t latency);
+
+// Free running cycle counter, e.g. dwt_read_cycle_counter. With it and a
+// clock every event's time from arrival to leaving the DAC is measured.
+void synth_set_cycle_counter(synth_clock_cb counter, uint32_t cycles_per_frame);
+
+// Queue a MIDI event from the USB side. Single producer, the functions
+// below are for the audio context only.
+void synth_queue_event(const MidiEvent *event);
+
+typedef struct SynthStats {
+    // Events dropped because the queue was full and the deepest it got
+    uint32_t overflows;
+    uint32_t max_depth;
+    // Arrival to audible in cycles, last, worst and averaged over ~16 events
+    uint32_t latency_last;
+    uint32_t latency_max;
+    uint32_t latency_average;
+    // From synth_calibrate_voices, the voices in use and the render cycles each costs per control period
+    uint32_t voice_limit;
+    uint32_t voice_cycles;
+} SynthStats;
+
+void synth_get_stats(SynthStats *stats);
+
+// Velocity 0 is a note-off
+void synth_note_on(uint8_t channel, uint8_t note, uint8_t velocity);
+
+void synth_note_off(uint8_t channel, uint8_t note);
+
+// Sustain pedal, CC 64
+void synth_sustain(bool down);
+
+void synth_all_notes_off(void);
+
+// Parameters behind controllers, smoothed at control rate. Each is on its
+// CC and on NRPN PARAM_NRPN_BANK / its number here, with 14-bit data entry.
+enum {
+    // CC 7 and 11, per channel
+    SYNTH_PARAM_VOLUME = 0,
+    SYNTH_PARAM_EXPRESSION,
+    // Mod wheel, LFO_CC_DEPTH
+    SYNTH_PARAM_VIBRATO,
+    SYNTH_PARAM_LFO_RATE,
+    // ENV_CC_ controllers
+    SYNTH_PARAM_ATTACK,
+    SYNTH_PARAM_DECAY,
+    SYNTH_PARAM_SUSTAIN,
+    SYNTH_PARAM_RELEASE,
+    // CC 80, 64 and up locks the LFO to one cycle per beat of the MIDI clock
+    SYNTH_PARAM_LFO_SYNC,
+    SYNTH_PARAMS,
+};
+
+// The SYNTH_PARAM_ controllers and NRPNs, sustain pedal and all notes off
+void synth_control_change(uint8_t channel, uint8_t cc, uint8_t value);
+
+uint8_t synth_active_voices(void);
+
+void synth_set_knob(int32_t value);
+
+// 14-bit MIDI pitch bend value per channel, 8192 is the center
+void synth_set_pitch_bend(uint8_t channel, uint16_t value);
+
+// Channel pressure deepens the vibrato like the mod wheel does
+void synth_channel_pressure(uint8_t channel, uint8_t value);
+
+// One of the OSC_ waveforms from oscillator.h
+void synth_set_waveform(uint8_t value);
+
+// Tempo of the incoming MIDI clock in BPM, Q8, 0 without one
+uint32_t synth_tempo(void);
+
+// Song position in beats, Q16, as of the last control tick
+uint32_t synth_beat_position(void);
+
+// Count of samples that went through the output limiter, for the distortion LED
+uint32_t synth_clip_count(void);
+
+// Render frames into out[frames * 2], right channel first
+void synth_render(uint16_t *out, uint32_t frames);
+
+// Time CONTROL_PERIOD frames with no voice and with all SYNTH_VOICES of them
+// playing, in the dearest waveform, and limit the polyphony to what fits in
+// budget cycles. Call it before audio starts, the synth is left silent at
+// the frame it was at. Returns the new limit.
+uint8_t synth_calibrate_voices(synth_clock_cb counter, uint32_t budget);
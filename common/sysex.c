@@ -0,0 +1,87 @@
+#include "sysex.h"
+
+void sysex_init(SysexReceiver *rx, uint8_t *buffer, uint32_t size) {
+    rx->buffer = buffer;
+    rx->size = size;
+    rx->len = 0;
+    rx->active = false;
+    rx->truncated = false;
+    rx->handler_count = 0;
+    rx->messages = 0;
+    rx->overflows = 0;
+    rx->dropped = 0;
+    rx->unhandled = 0;
+}
+
+bool sysex_register(SysexReceiver *rx, const uint8_t *prefix, uint8_t prefix_len, sysex_handler_cb handler) {
+    SysexHandler *h;
+    uint8_t i;
+
+    if(rx->handler_count >= SYSEX_HANDLERS || prefix_len > SYSEX_PREFIX) { return false; }
+
+    h = &rx->handlers[rx->handler_count++];
+    for(i = 0; i < prefix_len; i++) { h->prefix[i] = prefix[i]; }
+    h->prefix_len = prefix_len;
+    h->handler = handler;
+    return true;
+}
+
+static void sysex_dispatch(SysexReceiver *rx) {
+    const SysexHandler *h;
+    uint8_t i, j;
+
+    for(i = 0; i < rx->handler_count; i++) {
+        h = &rx->handlers[i];
+        // The prefix starts after 0xF0 and can't run into the 0xF7
+        if(rx->len < h->prefix_len + 2u) { continue; }
+        for(j = 0; j < h->prefix_len && rx->buffer[1 + j] == h->prefix[j]; j++) {}
+        if(j < h->prefix_len) { continue; }
+
+        h->handler(rx->buffer, rx->len);
+        return;
+    }
+
+    rx->unhandled++;
+}
+
+bool sysex_receive(SysexReceiver *rx, const MidiEvent *event) {
+    uint8_t cin = event->header & 0x0F;
+    uint8_t cable = event->header >> 4;
+    uint8_t bytes[3] = {event->status, event->data1, event->data2};
+    uint8_t length;
+    uint8_t i;
+
+    // CIN 0x5 is also a single byte system common message
+    if(cin < 0x4 || cin > 0x7) { return false; }
+    if(cin == 0x5 && event->status != 0xF7) { return false; }
+
+    if(event->status == 0xF0) {
+        // A new start abandons whatever was in progress
+        rx->active = true;
+        rx->cable = cable;
+        rx->len = 0;
+        rx->truncated = false;
+    } else if(!rx->active || cable != rx->cable) {
+        rx->dropped++;
+        return true;
+    }
+
+    // CIN 0x4 carries three bytes, 0x5 to 0x7 end the message with one to three
+    length = cin == 0x4 ? 3 : cin - 0x4;
+    if(rx->len + length > rx->size) {
+        rx->truncated = true;
+    } else {
+        for(i = 0; i < length; i++) { rx->buffer[rx->len++] = bytes[i]; }
+    }
+
+    if(cin == 0x4) { return true; }
+
+    rx->active = false;
+    if(rx->truncated) {
+        rx->overflows++;
+    } else {
+        rx->messages++;
+        sysex_dispatch(rx);
+    }
+    return true;
+}
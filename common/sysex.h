@@ -0,0 +1,54 @@
+#pragma once
+
+// Streaming SysEx receiver. USB-MIDI SysEx packets (CIN 0x4 to 0x7) are
+// written straight into a caller provided buffer, complete messages go to
+// the handler registered for their first bytes.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "midi_parser.h"
+
+#define SYSEX_HANDLERS 4
+#define SYSEX_PREFIX 4
+
+// message runs from 0xF0 to 0xF7 inclusive
+typedef void (*sysex_handler_cb)(const uint8_t *message, uint32_t len);
+
+typedef struct SysexHandler {
+    // Bytes after 0xF0 the message has to start with
+    uint8_t prefix[SYSEX_PREFIX];
+    uint8_t prefix_len;
+    sysex_handler_cb handler;
+} SysexHandler;
+
+typedef struct SysexReceiver {
+    uint8_t *buffer;
+    uint32_t size;
+    uint32_t len;
+    // A message is in progress, on this cable
+    bool active;
+    uint8_t cable;
+    // The message in progress didn't fit
+    bool truncated;
+
+    SysexHandler handlers[SYSEX_HANDLERS];
+    uint8_t handler_count;
+
+    uint32_t messages;
+    // Messages that didn't fit into the buffer
+    uint32_t overflows;
+    // Packets without a matching start, or from another cable mid-message
+    uint32_t dropped;
+    // Complete messages no handler wanted
+    uint32_t unhandled;
+} SysexReceiver;
+
+void sysex_init(SysexReceiver *rx, uint8_t *buffer, uint32_t size);
+
+// Returns false when all SYSEX_HANDLERS slots are taken
+bool sysex_register(SysexReceiver *rx, const uint8_t *prefix, uint8_t prefix_len, sysex_handler_cb handler);
+
+// Takes SysEx packets and returns true, anything else is left to the caller.
+// Handlers run from here.
+bool sysex_receive(SysexReceiver *rx, const MidiEvent *event);
@@ -1,6 +1,8 @@
 
 #include "tools.h"
 
+#include "exp2_table.h"
+
 void reverse(char *str, int length) {
     int start = 0;
     int end = length - 1;
@@ -59,7 +61,42 @@ int32_t fixed_exp2 (int32_t a)
     r = 0x00000e20;                 // 5.5171669058037949e-2
     r = (r * f + 0x3e1cc333) >> 17; // 2.4261112219321804e-1
     r = (r * f + 0x58bd46a6) >> 16; // 6.9326098546062365e-1
-    r = r * f + 0x7ffde4a3;         // 9.9992807353939517e-1
-    return (uint32_t)r >> s;
+    /* wraps past INT32_MAX, so in unsigned */
+    return ((uint32_t)r * f + 0x7ffde4a3u) >> s; // 9.9992807353939517e-1
+}
+
+/* exp2(a) in s15.16, -16 < a < 15, from exp2_table with linear interpolation */
+int32_t fixed_exp2_lut(int32_t a) {
+    int32_t i = a >> 16;
+    uint32_t f = a & 0xffff;
+    uint32_t index = f >> (16 - EXP2_LUT_BITS);
+    uint32_t weight = f & ((1 << (16 - EXP2_LUT_BITS)) - 1);
+    uint32_t y0 = exp2_table[index];
+    uint32_t y1 = exp2_table[index + 1];
+    /* Q30 mantissa in [1, 2) */
+    uint32_t r = y0 + (uint32_t)(((uint64_t)(y1 - y0) * weight) >> (16 - EXP2_LUT_BITS));
+    int32_t s = 14 - i;
+
+    if(s < 0) { return INT32_MAX; }
+    if(s == 0) { return r > INT32_MAX ? INT32_MAX : (int32_t)r; }
+    if(s >= 32) { return 0; }
+    return (r + (1u << (s - 1))) >> s;
 }
 
+/* log2(a) in s15.16 for a > 0 in s15.16, from log2_table with linear interpolation */
+int32_t fixed_log2_lut(uint32_t a) {
+    int n;
+    uint32_t m, index, weight, y0, y1;
+
+    if(a == 0) { return INT32_MIN; }
+
+    /* a = 2^(n - 16) * m, m normalized to [1, 2) with the top bit set */
+    n = 31 - __builtin_clz(a);
+    m = a << (31 - n);
+    index = (m >> (31 - EXP2_LUT_BITS)) & ((1 << EXP2_LUT_BITS) - 1);
+    weight = (m >> (15 - EXP2_LUT_BITS)) & 0xffff;
+    y0 = log2_table[index];
+    y1 = log2_table[index + 1];
+
+    return (n - 16) * 65536 + (int32_t)(y0 + (((y1 - y0) * weight + 0x8000) >> 16));
+}
@@ -1,6 +1,18 @@
+#pragma once
+
 #include <stdbool.h>
 #include <stdint.h>
 
 void reverse(char *str, int length);
 void itoa7(int32_t num, char *str);
-int32_t fixed_exp2 (int32_t a);
\ No newline at end of file
+int32_t fixed_exp2(int32_t a);
+
+// Table size for the LUT versions, 2^EXP2_LUT_BITS segments per octave.
+// 4, 6 or 8, bigger is more accurate and costs more flash.
+#ifndef EXP2_LUT_BITS
+#define EXP2_LUT_BITS 6
+#endif
+
+// exp2(a) and log2(a) in s15.16 with a table and linear interpolation
+int32_t fixed_exp2_lut(int32_t a);
+int32_t fixed_log2_lut(uint32_t a);
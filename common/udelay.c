@@ -1,15 +1,15 @@
 #include "udelay.h"
 
 void delay_setup(void) {
-    rcc_periph_clock_enable(RCC_TIM2);
-    timer_set_prescaler(TIM2, rcc_apb1_frequency / 1000000 - 1);
-    timer_set_period(TIM2, 0xffff);
-    timer_one_shot_mode(TIM2);
+    rcc_periph_clock_enable(RCC_TIM4);
+    timer_set_prescaler(TIM4, rcc_apb1_frequency / 1000000 - 1);
+    timer_set_period(TIM4, 0xffff);
+    timer_one_shot_mode(TIM4);
 }
 
 void delay_us(uint32_t us) {
-    TIM_ARR(TIM2) = us;
-    TIM_EGR(TIM2) = TIM_EGR_UG;
-    TIM_CR1(TIM2) |= TIM_CR1_CEN;
-    while(TIM_CR1(TIM2) & TIM_CR1_CEN) {}
+    TIM_ARR(TIM4) = us;
+    TIM_EGR(TIM4) = TIM_EGR_UG;
+    TIM_CR1(TIM4) |= TIM_CR1_CEN;
+    while(TIM_CR1(TIM4) & TIM_CR1_CEN) {}
 }
@@ -4,7 +4,7 @@
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/timer.h>
 
-// Uses TIM2
+// Uses TIM4
 
 void delay_setup(void);
 
@@ -0,0 +1,112 @@
+#include "voices.h"
+
+static uint16_t voice_release(Voices *v, uint8_t i) {
+    v->gate[i] = false;
+    v->sustained[i] = false;
+    if(v->stage[i] == ENV_IDLE || v->stage[i] == ENV_RELEASE) { return 0; }
+    v->stage[i] = ENV_RELEASE;
+    return 1 << i;
+}
+
+static uint8_t voice_allocate(Voices *v) {
+    uint8_t best = 0;
+    uint8_t i;
+
+    // A silent voice is free
+    for(i = 0; i < v->limit; i++) {
+        if(v->stage[i] == ENV_IDLE) { return i; }
+    }
+
+    // Then prefer released voices, quietest first
+    for(i = 0; i < v->limit; i++) {
+        if(v->gate[i] || v->sustained[i]) { continue; }
+        if(v->gate[best] || v->sustained[best] || v->level[i] < v->level[best]) { best = i; }
+    }
+    if(!v->gate[best] && !v->sustained[best]) { return best; }
+
+    // Everything is held, steal one
+    for(i = 1; i < v->limit; i++) {
+#if VOICE_STEAL == VOICE_STEAL_QUIETEST
+        if(v->level[i] < v->level[best]) { best = i; }
+#else
+        if((int32_t)(v->age[i] - v->age[best]) < 0) { best = i; }
+#endif
+    }
+
+    return best;
+}
+
+uint8_t voice_note_on(Voices *v, uint8_t channel, uint8_t note, uint8_t velocity) {
+    uint8_t i;
+
+    note &= 0x7F;
+
+    // Retrigger the same key instead of stacking voices
+    for(i = 0; i < SYNTH_VOICES; i++) {
+        if(v->stage[i] != ENV_IDLE && v->channel[i] == channel && v->note[i] == note - 69) { break; }
+    }
+    if(i == SYNTH_VOICES) { i = voice_allocate(v); }
+
+    v->note[i] = note - 69;
+    v->channel[i] = channel;
+    // The level carries on from where it was, so a stolen voice doesn't click
+    v->velocity[i] = velocity & 0x7F;
+    v->stage[i] = ENV_ATTACK;
+    v->gate[i] = true;
+    v->sustained[i] = false;
+    v->age[i] = v->age_counter++;
+
+    return i;
+}
+
+uint16_t voice_note_off(Voices *v, uint8_t channel, uint8_t note) {
+    uint16_t released = 0;
+    uint8_t i;
+
+    note &= 0x7F;
+
+    for(i = 0; i < SYNTH_VOICES; i++) {
+        if(!v->gate[i] || v->channel[i] != channel || v->note[i] != note - 69) { continue; }
+        if(v->sustain) {
+            v->gate[i] = false;
+            v->sustained[i] = true;
+        } else {
+            released |= voice_release(v, i);
+        }
+    }
+
+    return released;
+}
+
+uint16_t voice_sustain(Voices *v, bool down) {
+    uint16_t released = 0;
+    uint8_t i;
+
+    v->sustain = down;
+    if(down) { return 0; }
+
+    for(i = 0; i < SYNTH_VOICES; i++) {
+        if(v->sustained[i]) { released |= voice_release(v, i); }
+    }
+
+    return released;
+}
+
+uint16_t voice_all_off(Voices *v) {
+    uint16_t released = 0;
+    uint8_t i;
+
+    v->sustain = false;
+    for(i = 0; i < SYNTH_VOICES; i++) { released |= voice_release(v, i); }
+
+    return released;
+}
+
+uint8_t voice_active_count(Voices *v) {
+    uint8_t count = 0;
+    uint8_t i;
+
+    for(i = 0; i < SYNTH_VOICES; i++) { count += v->stage[i] != ENV_IDLE; }
+
+    return count;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// Polyphonic voice allocator. Voice state is kept as a struct of arrays
+// so the renderer can walk one voice over a whole block with its state
+// in registers.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "envelope.h"
+
+// Size of the voice pool, voice masks are 16 bits. How many of them get used is measured at
+// boot, synth_calibrate_voices lowers limit to what renders within the block deadline.
+#ifndef SYNTH_VOICES
+#define SYNTH_VOICES 16
+#endif
+
+#if SYNTH_VOICES < 1 || SYNTH_VOICES > 16
+#error "SYNTH_VOICES must be between 1 and 16"
+#endif
+
+// Which voice gets taken over when all of them are busy
+#define VOICE_STEAL_OLDEST 0
+#define VOICE_STEAL_QUIETEST 1
+
+#ifndef VOICE_STEAL
+#define VOICE_STEAL VOICE_STEAL_OLDEST
+#endif
+
+typedef struct Voices {
+    uint32_t phase[SYNTH_VOICES];
+    uint32_t increment[SYNTH_VOICES];
+    // Output gain, Q24. Ramps towards the envelope by gain_step per frame.
+    int32_t gain[SYNTH_VOICES];
+    int32_t gain_step[SYNTH_VOICES];
+    // Per frame pitch ramp towards the next control tick
+    int32_t increment_step[SYNTH_VOICES];
+    // Envelope level (Q30) and stage, see envelope.h
+    int32_t level[SYNTH_VOICES];
+    // Level before the last control tick's envelope step
+    int32_t start_level[SYNTH_VOICES];
+    uint8_t stage[SYNTH_VOICES];
+    uint8_t velocity[SYNTH_VOICES];
+    // Note number relative to A4 (69)
+    int16_t note[SYNTH_VOICES];
+    uint8_t channel[SYNTH_VOICES];
+    // Key is down
+    bool gate[SYNTH_VOICES];
+    // Key was released while the sustain pedal was down
+    bool sustained[SYNTH_VOICES];
+    // Note-on order, the smallest one is the oldest
+    uint32_t age[SYNTH_VOICES];
+    uint32_t age_counter;
+    bool sustain;
+    // The allocator hands out the first limit voices only, 1 to SYNTH_VOICES
+    uint8_t limit;
+} Voices;
+
+// Returns the voice that was (re)triggered
+uint8_t voice_note_on(Voices *v, uint8_t channel, uint8_t note, uint8_t velocity);
+
+// Returns a bit mask of the voices that went into release, same for the two below
+uint16_t voice_note_off(Voices *v, uint8_t channel, uint8_t note);
+
+uint16_t voice_sustain(Voices *v, bool down);
+
+// Release everything, e.g. on all-notes-off
+uint16_t voice_all_off(Voices *v);
+
+uint8_t voice_active_count(Voices *v);
@@ -1,3 +1,4 @@
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/adc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/i2c.h>
@@ -9,62 +10,143 @@
 #include "endless_encoder.h"
 #include "i2s_spi.h"
 #include "midi.h"
+#include "midi_stats.h"
+#include "midi_tx.h"
+#include "midi_uart.h"
 #include "ssd1306_128x32.h"
+#include "synth.h"
+#include "sysex.h"
 #include "tools.h"
 #include "udelay.h"
 
 usbd_device *usbd_dev;
 static const char *usb_strings[] = {"ambi.tech", "midifiddler", usb_serial_number};
-uint32_t total_received = 0;
+// Counted from the MIDI input interrupts
+static MidiStats midi_stats;
 
-uint32_t phase[4] = {0};
-uint16_t amplitude[4] = {0};
-int16_t notes[4] = {0};
+// SysEx uploads are reassembled here straight from the event packets
+static uint8_t sysex_buffer[512];
+static SysexReceiver sysex;
 
-uint8_t note_pointer = 0;
+// F0 7D 01 <channel> (<cc> <value>)* F7, a patch is a list of controller settings
+static void sysex_patch_load(const uint8_t *message, uint32_t len) {
+    MidiEvent event = {0x0B, 0xB0, 0, 0, 0, 0};
+    uint32_t i;
 
-int32_t knob = 0;
+    if(len < 5) { return; }
+    event.status |= message[3] & 0x0F;
 
-static void note_on(uint8_t note, uint8_t velocity) {
-    (void)velocity;
-    notes[note_pointer] = note - 69;
-    amplitude[note_pointer] = velocity * (65535 / 128);
+    for(i = 4; i + 2 < len; i += 2) {
+        event.data1 = message[i] & 0x7F;
+        event.data2 = message[i + 1] & 0x7F;
+        synth_queue_event(&event);
+    }
+}
+
+// F0 7E 7F 06 01 F7, answered with the F0 7E 00 06 02 ... F7 identity reply in sysex_identity from midi.h.
+// It goes out through midi_tx_sysex, so the reply is queued whole or not at all.
+static void sysex_identity_request(const uint8_t *message, uint32_t len) {
+    uint8_t reply[sizeof(sysex_identity)];
+    uint32_t n = 0;
+    uint32_t i, j;
+
+    (void)message;
+    (void)len;
+
+    // Back from the preformatted event packets to the message bytes
+    for(i = 0; i < sizeof(sysex_identity); i += 4) {
+        for(j = 0; j < midi_usb_cin_length(sysex_identity[i]); j++) { reply[n++] = sysex_identity[i + 1 + j]; }
+    }
+
+    midi_tx_sysex(reply, n);
+}
+
+// F0 7D 02 F7, answered with the counters in the layout of midi_stats_reply
+static void sysex_stats_request(const uint8_t *message, uint32_t len) {
+    static uint8_t reply[MIDI_STATS_REPLY_SIZE];
+    MidiStatsReport report;
+    SynthStats synth_stats;
+
+    (void)message;
+    (void)len;
+
+    synth_get_stats(&synth_stats);
+    report.midi = midi_stats;
+    report.queue_overflows = synth_stats.overflows;
+    report.queue_max_depth = synth_stats.max_depth;
+    report.latency_last = synth_stats.latency_last;
+    report.latency_max = synth_stats.latency_max;
+    report.latency_average = synth_stats.latency_average;
+    report.sysex_overflows = sysex.overflows;
+    report.sysex_dropped = sysex.dropped;
+    report.sysex_unhandled = sysex.unhandled;
+    report.tx_overflows = midi_tx_overflows();
+    report.fill_cycles_max = i2s_isr_cycles_max;
+    report.voice_limit = synth_stats.voice_limit;
+    report.voice_cycles = synth_stats.voice_cycles;
+
+    midi_tx_sysex(reply, midi_stats_reply(&report, reply));
+}
+
+static void sysex_setup(void) {
+    static const uint8_t patch_load[] = {0x7D, 0x01};
+    static const uint8_t stats_request[] = {0x7D, 0x02};
+    static const uint8_t identity_request[] = {0x7E, 0x7F, 0x06, 0x01};
 
-    note_pointer++;
-    if(note_pointer >= 3) { note_pointer = 0; }
+    sysex_init(&sysex, sysex_buffer, sizeof(sysex_buffer));
+    sysex_register(&sysex, patch_load, sizeof(patch_load), sysex_patch_load);
+    sysex_register(&sysex, stats_request, sizeof(stats_request), sysex_stats_request);
+    sysex_register(&sysex, identity_request, sizeof(identity_request), sysex_identity_request);
+}
+
+// Everything from USB and DIN, SysEx goes to the receiver and the rest to the synth
+static void midi_input(const MidiEvent *event) {
+    midi_stats_count(&midi_stats, event);
+    if(!sysex_receive(&sysex, event)) { synth_queue_event(event); }
 }
 
 static void usbmidi_data_rx_cb(usbd_device *ubd, uint8_t ep) {
     (void)ep;
 
-    char buf[64];
-    int len = usbd_ep_read_packet(ubd, 0x01, buf, 64);
+    uint8_t buf[64];
+    uint16_t len = usbd_ep_read_packet(ubd, 0x01, buf, 64);
 
-    // Note on
-    if(buf[1] == 144) { note_on(buf[2], buf[3]); }
+    // A bulk packet carries up to 16 events
+    midi_usb_parse(buf, len, midi_input);
+}
 
-    total_received++;
+// Test notes go through the same queue as USB and DIN MIDI. The queue
+// takes a single producer, so interrupts are held off for the push.
+static void queue_note(uint8_t status, uint8_t note, uint8_t velocity) {
+    MidiEvent event = {status >> 4, status, note, velocity, 0, 0};
+    cm_disable_interrupts();
+    synth_queue_event(&event);
+    cm_enable_interrupts();
 }
 
 static void usbmidi_set_config(usbd_device *ubd, uint16_t wValue) {
     (void)wValue;
     usbd_ep_setup(ubd, 0x01, USB_ENDPOINT_ATTR_BULK, 64, usbmidi_data_rx_cb);
-    usbd_ep_setup(ubd, 0x81, USB_ENDPOINT_ATTR_BULK, 64, NULL);
+    midi_tx_set_config(ubd);
 }
 
 // static void send_test_output(void) {
-//     char buf[4] = {
-//         0x08, /* USB framing: virtual cable 0, note on */
-//         0x80, /* MIDI command: note on, channel 1 */
+//     MidiEvent event = {
+//         0x08, /* USB framing: virtual cable 0, note off */
+//         0x80, /* MIDI command: note off, channel 1 */
 //         60,   /* Note 60 (middle C) */
 //         64,   /* "Normal" velocity */
+//         0,
+//         0,
 //     };
-//     while(usbd_ep_write_packet(usbd_dev, 0x81, buf, sizeof(buf)) == 0) {};
+//     midi_tx_send(&event);
 // }
 
 static void usb_midi_setup(void) {
     usbd_dev = usb_start(usb_strings);
     usbd_register_set_config_callback(usbd_dev, usbmidi_set_config);
+    midi_tx_init(usbd_dev);
+    usb_enable_irq();
 }
 
 static void adc_setup(void) {
@@ -106,53 +188,7 @@ static uint16_t read_adc_naiive(uint8_t channel) {
     return adc_read_regular(ADC1);
 }
 
-static void update_sample(void) {
-    int32_t sample = 0;
-    int32_t freq = 0;
-    int i;
-
-    for(i = 0; i < 3; i++) {
-        if(amplitude[i] > 0) { amplitude[i]--; }
-    }
-
-    freq = knob << 4;
-
-    for(i = 0; i < 3; i++) { phase[i] += 440 * fixed_exp2(((notes[i] << 16) + freq) / 12); }
-
-    // Square
-    // sample =  ((phase[0] < 32768) * 65635) / 4;
-    // sample += ((phase[1] < 32768) * 65635) / 4;
-    // sample += ((phase[2] < 32768) * 65635) / 4;
-
-    // Triangle
-    // if(phase[0] < 32768) {
-    //     sample = phase[0];
-    // } else {
-    //     sample = 32768 - (phase[0]-32768);
-    // }
-
-    // Saw
-    sample = 0;
-    for(i = 0; i < 3; i++) { sample += ((int32_t)(phase[i] / 65536) - 32768) * (amplitude[i] / 8) / 65536; }
-
-    // Distortion alert
-    if(sample > 32000 || sample < -32000) { gpio_toggle(GPIOC, GPIO13); }
-
-    // Convert to int16 output value
-    sample += 32768;
-    i2s_send(sample, sample);
-}
-
-// I2S SPI uses TIM3 and SPI1
-void tim3_isr() {
-    if(timer_get_flag(TIM3, TIM_SR_CC1IF)) {
-        timer_clear_flag(TIM3, TIM_SR_CC1IF);
-        update_sample();
-    }
-}
-
 int main(void) {
-    int i;
     struct SSD1306 ssd1306;
 
     rcc_clock_setup_pll(&rcc_hse_configs[RCC_CLOCK_HSE8_72MHZ]);
@@ -166,6 +202,15 @@ int main(void) {
     adc_setup();
     delay_setup();
     i2s_spi_setup();
+    synth_init();
+    synth_set_clock(i2s_frame_position, I2S_LATENCY_FRAMES);
+    synth_set_cycle_counter(dwt_read_cycle_counter, 72000000 / SYNTH_SAMPLE_RATE);
+    // As many voices as render in 3/4 of the block deadline, the rest is for USB, MIDI and the display
+    synth_calibrate_voices(dwt_read_cycle_counter, CONTROL_PERIOD * (72000000 / SYNTH_SAMPLE_RATE) * 3 / 4);
+    i2s_start(synth_render);
+    midi_stats_init(&midi_stats);
+    sysex_setup();
+    midi_uart_setup(midi_input);
 
     SSD1306_init(&ssd1306, I2C1);
 
@@ -181,17 +226,16 @@ int main(void) {
 
     uint16_t screen_saver = 0;
     uint8_t note_ct = 0;
-
-    for(i = 0; i < 400000; i++) { usbd_poll(usbd_dev); }
+    uint8_t test_note = 0;
+    uint32_t clips = 0;
 
     while(true) {
-        usbd_poll(usbd_dev);
-
         adc1 = read_adc_naiive(1);
         adc2 = read_adc_naiive(2);
 
         if(encoder_update(&pot, adc1, adc2)) { screen_saver = 0; }
 
+        SSD1306_wait(&ssd1306);
         SSD1306_clear(&ssd1306, 0x00);
 
         if(screen_saver < 30 * 20) {
@@ -205,7 +249,7 @@ int main(void) {
             SSD1306_print_number(&ssd1306, 8 * 5, 16, pot.total_value);
 
             SSD1306_draw_string(&ssd1306, 0, 24, "MIDI:");
-            SSD1306_print_number(&ssd1306, 8 * 5, 24, total_received);
+            SSD1306_print_number(&ssd1306, 8 * 5, 24, midi_stats.total);
 
             int px = 90 + (adc1 / 220);
             int py = (adc2 / 220);
@@ -216,22 +260,28 @@ int main(void) {
 
             screen_saver++;
 
-            knob = pot.total_value;
+            synth_set_knob(pot.total_value);
         }
 
         SSD1306_refresh(&ssd1306);
 
-        // 30fps
-        for(i = 0; i < 100; i++) {
-            usbd_poll(usbd_dev);
-            delay_us(1000000 / 3000);
+        // Distortion alert
+        if(synth_clip_count() != clips) {
+            clips = synth_clip_count();
+            gpio_toggle(GPIOC, GPIO13);
         }
 
+        // 30fps
+        delay_us(1000000 / 30);
+
         // Test notes
         note_ct++;
         if(note_ct > 20) {
             note_ct = 0;
-            note_on(60 + note_pointer * 4, 120);
+            queue_note(MIDI_NOTE_OFF, 60 + test_note * 4, 0);
+            test_note++;
+            if(test_note >= 3) { test_note = 0; }
+            queue_note(MIDI_NOTE_ON, 60 + test_note * 4, 120);
         }
     }
 
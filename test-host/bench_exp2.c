@@ -0,0 +1,50 @@
+// Host ns per call of the fixed point exp2 and log2 in tools.c. Only good
+// for comparing them with each other; Cortex-M cycles have to be counted
+// on the target.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "tools.h"
+
+#define CALLS 20000000
+
+static volatile uint32_t sink;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Arguments over the note range, -69 to +58 semitones from A4
+static double bench_exp2(int32_t (*fn)(int32_t)) {
+    double start = now();
+    uint32_t sum = 0;
+    int i;
+
+    for(i = 0; i < CALLS; i++) { sum += fn((i % 128 - 69) * 5461 + (i & 0xFF)); }
+    sink = sum;
+    return (now() - start) * 1e9 / CALLS;
+}
+
+static double bench_log2(void) {
+    double start = now();
+    uint32_t sum = 0;
+    uint32_t a = 1;
+    int i;
+
+    for(i = 0; i < CALLS; i++) {
+        sum += fixed_log2_lut(a);
+        a = a * 1664525u + 1013904223u;
+    }
+    sink = sum;
+    return (now() - start) * 1e9 / CALLS;
+}
+
+int main(void) {
+    printf("fixed_exp2      %.2f ns/call\n", bench_exp2(fixed_exp2));
+    printf("fixed_exp2_lut  %.2f ns/call (%d bits)\n", bench_exp2(fixed_exp2_lut), EXP2_LUT_BITS);
+    printf("fixed_log2_lut  %.2f ns/call (%d bits)\n", bench_log2(), EXP2_LUT_BITS);
+    return 0;
+}
@@ -0,0 +1,108 @@
+// SSD1306_draw_char against the routine it replaced, which set the 64
+// pixels one at a time from a row-major font. First every glyph at every
+// position is compared with a clipped per-pixel reference, then both
+// routines draw the same mixed string, on page boundaries and straddling
+// two pages. Host glyphs per second, the F103's would need the board.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "font8x8_basic.h"
+#include "ssd1306_128x32.h"
+
+#define DRAWS 4000000
+
+// The font as it was written, 8 rows, bit 0 the leftmost pixel
+static uint8_t rows[96][8];
+
+static void font_rows(void) {
+    int glyph, row, col;
+
+    for(glyph = 0; glyph < 96; glyph++) {
+        for(row = 0; row < 8; row++) {
+            for(col = 0; col < 8; col++) { rows[glyph][row] |= ((font8x8_basic[glyph][col] >> row) & 1) << col; }
+        }
+    }
+}
+
+// The routine before the column-major font, it didn't clip
+static void old_draw_char(struct SSD1306 *ssd1306, uint8_t x, uint8_t y, char ch) {
+    uint8_t i, j;
+    uint8_t selchar = ((int)ch) - 32;
+    for(i = 0; i < 8; i++) {
+        uint8_t line = rows[selchar][i];
+        uint8_t y_seg = (y + i) & 0x07;
+        for(j = 0; j < 8; j++, line >>= 1) {
+            ssd1306->screen_data[((x + j) + ((y + i) >> 3) * ssd1306->width) & 0xFFF] |= (line & 1) << y_seg;
+        }
+    }
+}
+
+static void reference_draw_char(uint8_t *screen, int x, int y, char ch) {
+    int i, j;
+
+    for(i = 0; i < 8; i++) {
+        for(j = 0; j < 8; j++) {
+            if(!((rows[ch - 32][i] >> j) & 1) || x + j >= WIDTH || y + i >= HEIGHT) { continue; }
+            screen[x + j + ((y + i) >> 3) * WIDTH] |= 1 << ((y + i) & 7);
+        }
+    }
+}
+
+// Positions where the new routine differs from the reference
+static uint32_t mismatches(struct SSD1306 *ssd1306) {
+    static uint8_t reference[sizeof(ssd1306->screen_data)];
+    uint32_t count = 0;
+    int ch, x, y;
+
+    for(ch = 32; ch < 128; ch++) {
+        for(x = 0; x < WIDTH; x++) {
+            for(y = 0; y < HEIGHT; y++) {
+                memset(ssd1306->screen_data, 0, sizeof(ssd1306->screen_data));
+                memset(reference, 0, sizeof(reference));
+                SSD1306_draw_char(ssd1306, x, y, ch);
+                reference_draw_char(reference, x, y, ch);
+                count += memcmp(ssd1306->screen_data, reference, sizeof(reference)) != 0;
+            }
+        }
+    }
+    return count;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Million glyphs per second, y offset from the page boundary
+static double draws(struct SSD1306 *ssd1306, void (*draw)(struct SSD1306 *, uint8_t, uint8_t, char), uint8_t offset) {
+    static const char text[] = "ADC1:1234MIDI:-567";
+    double start = now();
+    uint32_t i;
+
+    for(i = 0; i < DRAWS; i++) { draw(ssd1306, i * 8 % 120, i % 3 * 8 + offset, text[i % (sizeof(text) - 1)]); }
+    return DRAWS / (now() - start) * 1e-6;
+}
+
+int main(void) {
+    static struct SSD1306 ssd1306;
+    static const uint8_t offsets[] = {0, 3};
+    unsigned i;
+
+    ssd1306.width = WIDTH;
+    ssd1306.height = HEIGHT;
+    ssd1306.screen_data_length = sizeof(ssd1306.screen_data);
+    font_rows();
+
+    printf("%u of %u glyph positions differ from the reference\n", mismatches(&ssd1306), 96 * WIDTH * HEIGHT);
+    for(i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        double before = draws(&ssd1306, old_draw_char, offsets[i]);
+        double after = draws(&ssd1306, SSD1306_draw_char, offsets[i]);
+        printf("y = 8n+%u: per pixel %6.1f M glyphs/s, per column %6.1f M glyphs/s, %4.1fx\n", offsets[i], before,
+               after, after / before);
+    }
+
+    return 0;
+}
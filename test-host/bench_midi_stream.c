@@ -0,0 +1,115 @@
+// Host bytes per second through midi_stream_parse, on a stream like a DIN
+// keyboard and sequencer would send: notes and controllers in running
+// status, 0xF8 clock bytes dropped in between and inside messages, pitch
+// bends, a song position and SysEx dumps short and long. It is fed in
+// spans like the UART's DMA interrupts hand over, and in one go. DIN
+// delivers at most 3125 bytes/s; the target's figure needs the board.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "midi_stream.h"
+
+#define STREAM_SIZE 4096
+#define PASSES 20000
+
+static uint8_t stream[STREAM_SIZE];
+static uint32_t stream_len;
+static uint32_t events;
+
+static void count(const MidiEvent *event) {
+    (void)event;
+    events++;
+}
+
+static void put(uint8_t byte) {
+    if(stream_len < STREAM_SIZE) { stream[stream_len++] = byte; }
+    // A clock byte every 24 bytes, wherever it lands
+    if(stream_len % 24 == 0 && stream_len < STREAM_SIZE) { stream[stream_len++] = 0xF8; }
+}
+
+static void record(void) {
+    uint32_t i, n, seed = 1;
+
+    while(stream_len < STREAM_SIZE - 300) {
+        seed = seed * 1664525u + 1013904223u;
+        switch(seed >> 29) {
+            case 0:
+            case 1:
+                // A chord in running status, note-ons and velocity 0 note-offs
+                put(0x90);
+                for(i = 0; i < 8; i++) {
+                    put(48 + i * 4);
+                    put(i < 4 ? 100 : 0);
+                }
+                break;
+            case 2:
+                // Mod wheel sweep in running status
+                put(0xB0);
+                for(i = 0; i < 16; i++) {
+                    put(1);
+                    put(i * 8);
+                }
+                break;
+            case 3:
+                put(0xE0);
+                for(i = 0; i < 8; i++) {
+                    put(0);
+                    put(64 + i);
+                }
+                break;
+            case 4:
+                // Song position, program change, channel pressure
+                put(0xF2);
+                put(seed & 0x7F);
+                put(0);
+                put(0xC0);
+                put(seed >> 8 & 0x03);
+                put(0xD0);
+                put(seed >> 16 & 0x7F);
+                break;
+            default:
+                // SysEx of 4 to 259 bytes
+                n = 4 + (seed >> 8 & 0xFF);
+                put(0xF0);
+                for(i = 0; i < n; i++) { put(i & 0x7F); }
+                put(0xF7);
+                break;
+        }
+    }
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void run(uint32_t span) {
+    MidiStream parser;
+    double start, seconds;
+    uint32_t pass, i;
+
+    midi_stream_init(&parser, 1);
+    events = 0;
+    start = now();
+    for(pass = 0; pass < PASSES; pass++) {
+        for(i = 0; i < stream_len; i += span) {
+            midi_stream_parse(&parser, &stream[i], stream_len - i < span ? stream_len - i : span, count);
+        }
+    }
+    seconds = now() - start;
+
+    printf("%4u byte spans: %6.1f MB/s, %5.1f ns/byte, %u events per pass\n", span,
+           (double)stream_len * PASSES / seconds * 1e-6, seconds * 1e9 / ((double)stream_len * PASSES),
+           events / PASSES);
+}
+
+int main(void) {
+    record();
+    printf("%u byte stream, %u passes\n", stream_len, PASSES);
+    run(32);
+    run(stream_len);
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+// USB-MIDI IN throughput of the midi_tx ring, against a simulated bulk
+// endpoint. The host takes at most packets_per_frame packets per 1 ms
+// frame, evenly spread; each take runs the complete callback, which arms
+// the next packet. One per frame is the floor: only the start of frame
+// flush gets anything out. A producer offers events at a fixed rate for
+// one second, the bench reports events per second delivered, dropped ones
+// and whether they came out in order. The unbatched sender this replaced
+// put one event in each packet, its ceiling is packets_per_frame * 1000.
+//
+// Also the host CPU time per event through midi_tx_send and the flush.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "midi_tx.h"
+
+#define SIM_US 1000000
+
+static void (*sof_callback)(void);
+static usbd_endpoint_callback complete_callback;
+static char dummy_device;
+
+// Packet armed on the endpoint and waiting for the host
+static bool armed;
+static uint8_t armed_packet[MIDI_TX_PACKET_SIZE];
+static uint16_t armed_len;
+
+static uint32_t delivered;
+static uint32_t out_of_order;
+static uint32_t last_seq;
+
+void usbd_register_sof_callback(usbd_device *usbd_dev, void (*callback)(void)) {
+    (void)usbd_dev;
+    sof_callback = callback;
+}
+
+void usbd_ep_setup(usbd_device *usbd_dev, uint8_t addr, uint8_t type, uint16_t max_size,
+                   usbd_endpoint_callback callback) {
+    (void)usbd_dev;
+    (void)addr;
+    (void)type;
+    (void)max_size;
+    complete_callback = callback;
+}
+
+uint16_t usbd_ep_write_packet(usbd_device *usbd_dev, uint8_t addr, const void *buf, uint16_t len) {
+    const uint8_t *bytes = buf;
+    uint16_t i;
+
+    (void)usbd_dev;
+    (void)addr;
+    if(armed) { return 0; }
+    for(i = 0; i < len; i++) { armed_packet[i] = bytes[i]; }
+    armed_len = len;
+    armed = true;
+    return len;
+}
+
+// The host reads the armed packet. Events carry a 14-bit sequence number
+// in the data bytes, it has to go up, dropped events leave gaps.
+static void host_take(void) {
+    uint32_t seq, step;
+    uint16_t i;
+
+    if(!armed) { return; }
+    for(i = 0; i < armed_len; i += 4) {
+        seq = armed_packet[i + 2] | (armed_packet[i + 3] << 7);
+        step = (seq - last_seq) & 0x3FFF;
+        if(step == 0 || step >= 0x2000) { out_of_order++; }
+        last_seq = seq;
+        delivered++;
+    }
+    armed = false;
+    complete_callback((usbd_device *)&dummy_device, MIDI_TX_ENDPOINT);
+}
+
+static void reset(void) {
+    usbd_device *dev = (usbd_device *)&dummy_device;
+
+    armed = false;
+    delivered = 0;
+    out_of_order = 0;
+    last_seq = 0x3FFF;
+    midi_tx_init(dev);
+    midi_tx_set_config(dev);
+}
+
+static void simulate(uint32_t offered_rate, uint32_t packets_per_frame) {
+    uint32_t offered = 0, in_time = 0;
+    uint32_t t, due;
+
+    reset();
+
+    // One second of offered load, then 100ms more to drain the ring
+    for(t = 0; t < SIM_US + SIM_US / 10; t++) {
+        for(due = t < SIM_US ? (uint32_t)((uint64_t)t * offered_rate / SIM_US) : offered; offered < due; offered++) {
+            MidiEvent event = {0x09, 0x90, (uint8_t)(offered & 0x7F), (uint8_t)((offered >> 7) & 0x7F), 0, 0};
+            midi_tx_send(&event);
+        }
+        if(t == SIM_US) { in_time = delivered; }
+        if(t % 1000 == 0) { sof_callback(); }
+        if(t % 1000 % (1000 / packets_per_frame) == 0) { host_take(); }
+    }
+
+    printf("offered %6u/s, %2u packets/frame: delivered %6u/s, dropped %6u, lost %d, out of order %u "
+           "(unbatched ceiling %5u/s)\n",
+           offered_rate, packets_per_frame, in_time, midi_tx_overflows(),
+           (int)(offered - delivered - midi_tx_overflows()), out_of_order, packets_per_frame * 1000);
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// An endpoint that takes every packet, the cost is the ring and the packing
+static void cpu_cost(void) {
+    const uint32_t events = 20000000;
+    double start;
+    uint32_t i;
+
+    reset();
+
+    start = now();
+    for(i = 0; i < events; i++) {
+        MidiEvent event = {0x09, 0x90, (uint8_t)(i & 0x7F), (uint8_t)((i >> 7) & 0x7F), 0, 0};
+        midi_tx_send(&event);
+        // Full packets, flushed and taken straight away
+        if((i & 15) == 15) {
+            sof_callback();
+            host_take();
+        }
+    }
+    printf("host CPU: %.1f ns/event, %u out of order\n", (now() - start) * 1e9 / events, out_of_order);
+}
+
+int main(void) {
+    static const uint32_t rates[] = {1000, 3125, 10000, 16000, 50000, 200000};
+    static const uint32_t packets_per_frame[] = {1, 4, 20};
+    unsigned i, j;
+
+    for(j = 0; j < sizeof(packets_per_frame) / sizeof(packets_per_frame[0]); j++) {
+        for(i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) { simulate(rates[i], packets_per_frame[j]); }
+    }
+    cpu_cost();
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+// The oscillators in oscillator.h against the naive waveforms they
+// replaced: host time per sample and alias energy, the part of the output
+// that isn't at a harmonic of the note, relative to all of it. Alias is
+// taken from a 64k point Blackman-Harris windowed FFT at the synth's
+// sample rate. The times are host times, cycles per voice on the target
+// show up in i2s_isr_cycles in the stats reply.
+//
+// The budget they have to fit on the Cortex-M3: 72 MHz / 50 kHz is 1440
+// cycles per stereo frame for everything, which over SYNTH_VOICES = 16
+// voices leaves 90 cycles per voice and sample before the mixing, the
+// envelopes and the interrupts take their share.
+
+#include <complex.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "oscillator.h"
+#include "synth.h"
+
+#define FFT_SIZE (1 << 16)
+#define TIMED_SAMPLES 20000000
+
+static const char *names[OSC_WAVEFORMS] = {"saw", "square", "triangle"};
+
+// The waveforms without the corrections
+static int32_t naive_sample(uint8_t waveform, uint32_t t) {
+    int32_t y = (int32_t)(t >> 16) - 32768;
+
+    switch(waveform) {
+        case OSC_SQUARE: return t < 0x80000000u ? 32767 : -32768;
+        case OSC_TRIANGLE:
+            y = 2 * (y < 0 ? -y : y) - 32768;
+            return y > 32767 ? 32767 : y;
+        default: return y;
+    }
+}
+
+static int32_t sample(uint8_t waveform, uint32_t t, uint32_t dt, bool limited) {
+    return limited ? osc_sample(waveform, t, dt) : naive_sample(waveform, t);
+}
+
+static uint32_t increment(double frequency) { return (uint32_t)(frequency / SYNTH_SAMPLE_RATE * 4294967296.0); }
+
+static void fft(double complex *a, int n) {
+    int i, j, k, len;
+
+    for(i = 1, j = 0; i < n; i++) {
+        for(k = n >> 1; j & k; k >>= 1) { j ^= k; }
+        j ^= k;
+        if(i < j) {
+            double complex t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+
+    for(len = 2; len <= n; len <<= 1) {
+        double complex w = cexp(-2 * M_PI * I / len);
+        for(i = 0; i < n; i += len) {
+            double complex wn = 1;
+            for(j = 0; j < len / 2; j++) {
+                double complex u = a[i + j], v = a[i + j + len / 2] * wn;
+                a[i + j] = u + v;
+                a[i + j + len / 2] = u - v;
+                wn *= w;
+            }
+        }
+    }
+}
+
+// Non-harmonic energy over total, in dB
+static double alias_db(uint8_t waveform, double frequency, bool limited) {
+    static double complex a[FFT_SIZE];
+    const double bin = (double)SYNTH_SAMPLE_RATE / FFT_SIZE;
+    uint32_t dt = increment(frequency), t = 12345;
+    double harmonic = 0, total = 0;
+    int n;
+
+    for(n = 0; n < FFT_SIZE; n++) {
+        double x = 2 * M_PI * n / FFT_SIZE;
+        double window = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x);
+        t += dt;
+        a[n] = sample(waveform, t, dt, limited) / 32768.0 * window;
+    }
+    fft(a, FFT_SIZE);
+
+    // The window's main lobe is 4 bins either side
+    for(n = 1; n < FFT_SIZE / 2; n++) {
+        double energy = creal(a[n] * conj(a[n]));
+        double h = round(n * bin / frequency);
+        total += energy;
+        if(h >= 1 && h * frequency < SYNTH_SAMPLE_RATE / 2 && fabs(n * bin - h * frequency) < 5 * bin) {
+            harmonic += energy;
+        }
+    }
+
+    return 10 * log10((total - harmonic) / total);
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Host ns per sample, over a sweep of notes so the corrections run as
+// often as they would across the keyboard
+static double ns_per_sample(uint8_t waveform, bool limited) {
+    volatile uint32_t sink;
+    uint32_t sum = 0;
+    uint32_t t = 0, dt = 0;
+    double start = now();
+    int n;
+
+    for(n = 0; n < TIMED_SAMPLES; n++) {
+        if((n & 1023) == 0) { dt = increment(50.0 + (n >> 10) % 64 * 100.0); }
+        t += dt;
+        sum += sample(waveform, t, dt, limited);
+    }
+    sink = sum;
+    (void)sink;
+
+    return (now() - start) * 1e9 / TIMED_SAMPLES;
+}
+
+int main(void) {
+    static const double frequencies[] = {1234.5, 4321.1, 7777.7};
+    uint8_t w;
+    unsigned i;
+
+    printf("Cortex-M3 budget at 72 MHz: %u cycles per frame, %u per voice and sample with %u voices\n",
+           72000000 / SYNTH_SAMPLE_RATE, 72000000 / SYNTH_SAMPLE_RATE / SYNTH_VOICES, SYNTH_VOICES);
+    for(w = 0; w < OSC_WAVEFORMS; w++) {
+        printf("%-8s naive %5.2f ns/sample, band-limited %5.2f ns/sample\n", names[w], ns_per_sample(w, false),
+               ns_per_sample(w, true));
+        for(i = 0; i < sizeof(frequencies) / sizeof(frequencies[0]); i++) {
+            printf("%-8s %6.0f Hz alias %6.1f -> %6.1f dB\n", names[w], frequencies[i],
+                   alias_db(w, frequencies[i], false), alias_db(w, frequencies[i], true));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Host time for one DMA half block of synth_render, for each waveform
+// with no voice up to all of them playing, next to the time the DMA takes
+// to send the other half. The fill has to finish within that on the
+// target; these are host times, the target's are in i2s_isr_cycles and
+// i2s_isr_cycles_max. The DMA itself can only be timed on the board.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../common/synth.c"
+
+// I2S_BLOCK_FRAMES in i2s_spi.h, which needs libopencm3
+#define BLOCK_FRAMES 32
+#define BLOCKS 20000
+#define RUNS 5
+
+static const char *names[OSC_WAVEFORMS] = {"saw", "square", "triangle"};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Host ns per block with this many voices held, the best of RUNS
+static double ns_per_block(uint8_t wave, uint8_t count) {
+    static uint16_t out[BLOCK_FRAMES * 2];
+    double start, best = 1e9, ns;
+    uint32_t block;
+    uint8_t i;
+
+    // From power-on, no voices left over from the last row
+    synth_init();
+    synth_set_waveform(wave);
+    for(i = 0; i < count; i++) { synth_note_on(0, 36 + i * 3, 100); }
+    // Past the attack, so the voices render at their held level
+    for(block = 0; block < 1000; block++) { synth_render(out, BLOCK_FRAMES); }
+
+    for(i = 0; i < RUNS; i++) {
+        start = now();
+        for(block = 0; block < BLOCKS; block++) { synth_render(out, BLOCK_FRAMES); }
+        ns = (now() - start) * 1e9 / BLOCKS;
+        if(ns < best) { best = ns; }
+    }
+    return best;
+}
+
+int main(void) {
+    const double deadline = BLOCK_FRAMES * 1e9 / SYNTH_SAMPLE_RATE;
+    uint8_t wave, count;
+
+    printf("block of %u frames, sent by the DMA in %.0f ns\n", BLOCK_FRAMES, deadline);
+    for(wave = 0; wave < OSC_WAVEFORMS; wave++) {
+        for(count = 0; count <= SYNTH_VOICES; count += SYNTH_VOICES / 4) {
+            double ns = ns_per_block(wave, count);
+            printf("%-8s %2u voices: %8.0f ns/block, %5.2f%% of the block\n", names[wave], synth_active_voices(), ns,
+                   100 * ns / deadline);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Host events per second through the synth's stamped event path: queued
+// with synth_queue_event, stamped against a fake clock and applied at
+// their frame by synth_render. Each block takes a burst of mod wheel
+// events spread over its frames. Controllers leave the voices alone, so
+// subtracting the render time without events leaves the per event cost of
+// queueing, stamping, block splitting and dispatch.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../common/synth.c"
+
+#define BLOCKS 200000
+
+static uint32_t play_frame;
+
+static uint32_t fake_clock(void) { return play_frame; }
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Seconds for BLOCKS blocks with events_per_block events each
+static double run(uint32_t events_per_block) {
+    static uint16_t out[CONTROL_PERIOD * 2];
+    double start;
+    uint32_t block, i;
+
+    synth_init();
+    synth_set_clock(fake_clock, 0);
+    play_frame = render_frame;
+    // A chord playing throughout, as it would be
+    for(i = 0; i < 4; i++) { synth_note_on(0, 48 + i * 4, 100); }
+
+    start = now();
+    for(block = 0; block < BLOCKS; block++) {
+        for(i = 0; i < events_per_block; i++) {
+            MidiEvent event = {0x0B, 0xB0, 1, (uint8_t)((block + i) & 0x7F), 0, 0};
+            // Stamped evenly over the block
+            play_frame = render_frame + i * CONTROL_PERIOD / events_per_block;
+            synth_queue_event(&event);
+        }
+        synth_render(out, CONTROL_PERIOD);
+    }
+    return now() - start;
+}
+
+int main(void) {
+    static const uint32_t bursts[] = {2, 8, 16, 32};
+    double idle = run(0);
+    unsigned i;
+
+    printf("render only: %.1f ns/block\n", idle * 1e9 / BLOCKS);
+    for(i = 0; i < sizeof(bursts) / sizeof(bursts[0]); i++) {
+        double busy = run(bursts[i]);
+        double per_event = (busy - idle) / ((double)BLOCKS * bursts[i]);
+        printf("%2u events/block: %.1f ns/event, %.2f M events/s\n", bursts[i], per_event * 1e9, 1e-6 / per_event);
+    }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Host bytes per second through sysex_receive: patch uploads of several
+// sizes, already split into USB-MIDI packets, reassembled into a buffer
+// the size of the firmware's and handed to a handler. A 64 byte USB bulk
+// packet holds 16 event packets, 48 SysEx bytes, so the bus rather than
+// the receiver sets the rate; the target's figure needs the board.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "sysex.h"
+
+#define BYTES (64 * 1024 * 1024)
+
+static uint32_t handled;
+
+static void patch_load(const uint8_t *message, uint32_t len) {
+    (void)message;
+    handled += len;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void run(uint32_t message_len) {
+    static const uint8_t prefix[] = {0x7D, 0x01};
+    static uint8_t buffer[512];
+    static MidiEvent packets[512 / 3 + 1];
+    SysexReceiver rx;
+    uint32_t count = 0, i, n, messages;
+    double start, seconds;
+
+    // F0 7D 01 <data> F7 as packets, CIN 0x4 and the ending one
+    for(i = 0; i < message_len; i += n) {
+        MidiEvent *event = &packets[count++];
+        uint8_t bytes[3] = {0, 0, 0};
+        uint32_t j;
+
+        n = message_len - i > 3 ? 3 : message_len - i;
+        for(j = 0; j < n; j++) {
+            uint32_t k = i + j;
+            bytes[j] = k == 0 ? 0xF0 : k == 1 ? 0x7D : k == 2 ? 0x01 : k == message_len - 1 ? 0xF7 : k & 0x7F;
+        }
+        event->header = i + n == message_len ? 0x4 + n : 0x4;
+        event->status = bytes[0];
+        event->data1 = bytes[1];
+        event->data2 = bytes[2];
+        event->time = 0;
+        event->arrival = 0;
+    }
+
+    sysex_init(&rx, buffer, sizeof(buffer));
+    sysex_register(&rx, prefix, sizeof(prefix), patch_load);
+    handled = 0;
+    messages = BYTES / message_len;
+
+    start = now();
+    while(messages--) {
+        for(i = 0; i < count; i++) { sysex_receive(&rx, &packets[i]); }
+    }
+    seconds = now() - start;
+
+    printf("%3u byte messages: %6.1f MB/s, %4.2f ns/byte, %u overflows\n", message_len, handled / seconds * 1e-6,
+           seconds * 1e9 / handled, rx.overflows);
+}
+
+int main(void) {
+    static const uint32_t sizes[] = {6, 32, 128, 512};
+    unsigned i;
+
+    for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) { run(sizes[i]); }
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// Minimal checks for the host tests: failures are counted and reported,
+// the test carries on so one run shows everything that is off.
+
+#include <stdint.h>
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if(!(cond)) {                                                        \
+            fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            check_failures++;                                                \
+        }                                                                    \
+    } while(0)
+
+#define CHECK_EQ(a, b)                                                                                     \
+    do {                                                                                                   \
+        long long check_a = (long long)(a);                                                                \
+        long long check_b = (long long)(b);                                                                \
+        if(check_a != check_b) {                                                                           \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s): %lld != %lld\n", __FILE__, __LINE__, #a, #b, check_a, \
+                    check_b);                                                                              \
+            check_failures++;                                                                              \
+        }                                                                                                  \
+    } while(0)
+
+// Exit status for main
+static inline int check_done(void) {
+    if(check_failures) {
+        printf("%d check(s) failed\n", check_failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
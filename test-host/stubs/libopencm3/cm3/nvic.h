@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for the parts of the libopencm3 NVIC API the common
+// modules use. The test that links them provides the functions.
+
+#include <stdint.h>
+
+#define NVIC_DMA1_CHANNEL6_IRQ 16
+#define NVIC_I2C1_EV_IRQ 31
+#define NVIC_I2C1_ER_IRQ 32
+
+void nvic_enable_irq(uint8_t irqn);
+void nvic_set_priority(uint8_t irqn, uint8_t priority);
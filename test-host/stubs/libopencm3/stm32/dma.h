@@ -0,0 +1,29 @@
+#pragma once
+
+// Host stand-in for the parts of the libopencm3 F1 DMA API the common
+// modules use. The test that links them provides the functions.
+
+#include <stdint.h>
+
+#define DMA1 0x40020000u
+#define DMA_CHANNEL6 6
+
+#define DMA_TCIF (1 << 1)
+
+#define DMA_CCR_PSIZE_8BIT (0x0 << 8)
+#define DMA_CCR_MSIZE_8BIT (0x0 << 10)
+#define DMA_CCR_PL_LOW (0x0 << 12)
+
+void dma_channel_reset(uint32_t dma, uint8_t channel);
+void dma_set_peripheral_address(uint32_t dma, uint8_t channel, uint32_t address);
+void dma_set_memory_address(uint32_t dma, uint8_t channel, uint32_t address);
+void dma_set_number_of_data(uint32_t dma, uint8_t channel, uint16_t number);
+void dma_set_read_from_memory(uint32_t dma, uint8_t channel);
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t channel);
+void dma_set_peripheral_size(uint32_t dma, uint8_t channel, uint32_t peripheral_size);
+void dma_set_memory_size(uint32_t dma, uint8_t channel, uint32_t mem_size);
+void dma_set_priority(uint32_t dma, uint8_t channel, uint32_t prio);
+void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t channel);
+void dma_enable_channel(uint32_t dma, uint8_t channel);
+void dma_disable_channel(uint32_t dma, uint8_t channel);
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t channel, uint32_t interrupts);
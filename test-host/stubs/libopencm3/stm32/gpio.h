@@ -0,0 +1,18 @@
+#pragma once
+
+// Host stand-in for the parts of the libopencm3 F1 GPIO API the common
+// modules use. The test that links them provides the functions.
+
+#include <stdint.h>
+
+#define GPIOB 0x40010C00u
+
+#define GPIO6 (1 << 6)
+#define GPIO7 (1 << 7)
+#define GPIO_I2C1_SCL GPIO6
+#define GPIO_I2C1_SDA GPIO7
+
+#define GPIO_MODE_OUTPUT_50_MHZ 0x03
+#define GPIO_CNF_OUTPUT_ALTFN_OPENDRAIN 0x03
+
+void gpio_set_mode(uint32_t gpioport, uint8_t mode, uint8_t cnf, uint16_t gpios);
@@ -0,0 +1,47 @@
+#pragma once
+
+// Host stand-in for the parts of the libopencm3 F1 I2C API the common
+// modules use. The test that links them provides the functions, and
+// i2c_register() in place of the memory mapped registers, so that reading
+// SR2 can clear ADDR the way the peripheral does.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define I2C1 0x40005400u
+
+volatile uint32_t *i2c_register(uint32_t address);
+
+#define I2C_DR(i2c_base) (*i2c_register((i2c_base) + 0x10))
+#define I2C_SR1(i2c_base) (*i2c_register((i2c_base) + 0x14))
+#define I2C_SR2(i2c_base) (*i2c_register((i2c_base) + 0x18))
+
+#define I2C_SR1_SB (1 << 0)
+#define I2C_SR1_ADDR (1 << 1)
+#define I2C_SR1_BTF (1 << 2)
+#define I2C_SR1_TxE (1 << 7)
+#define I2C_SR1_BERR (1 << 8)
+#define I2C_SR1_ARLO (1 << 9)
+#define I2C_SR1_AF (1 << 10)
+#define I2C_SR1_OVR (1 << 11)
+
+#define I2C_CR2_ITERREN (1 << 8)
+#define I2C_CR2_ITEVTEN (1 << 9)
+
+#define I2C_WRITE 0
+
+void i2c_transfer7(uint32_t i2c, uint8_t addr, const uint8_t *w, size_t wn, uint8_t *r, size_t rn);
+void i2c_peripheral_disable(uint32_t i2c);
+void i2c_peripheral_enable(uint32_t i2c);
+void i2c_set_clock_frequency(uint32_t i2c, uint8_t freq);
+void i2c_set_fast_mode(uint32_t i2c);
+void i2c_set_ccr(uint32_t i2c, uint16_t freq);
+void i2c_set_trise(uint32_t i2c, uint16_t trise);
+void i2c_send_start(uint32_t i2c);
+void i2c_send_stop(uint32_t i2c);
+void i2c_send_7bit_address(uint32_t i2c, uint8_t slave, uint8_t readwrite);
+void i2c_send_data(uint32_t i2c, uint8_t data);
+void i2c_enable_interrupt(uint32_t i2c, uint32_t interrupt);
+void i2c_disable_interrupt(uint32_t i2c, uint32_t interrupt);
+void i2c_enable_dma(uint32_t i2c);
+void i2c_disable_dma(uint32_t i2c);
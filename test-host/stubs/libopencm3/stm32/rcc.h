@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for the parts of the libopencm3 RCC API the common
+// modules use. The test that links them provides the functions.
+
+#include <stdint.h>
+
+enum rcc_periph_clken {
+    RCC_AFIO,
+    RCC_GPIOB,
+    RCC_DMA1,
+    RCC_I2C1,
+};
+
+void rcc_periph_clock_enable(enum rcc_periph_clken clken);
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in for the parts of the libopencm3 USB device API the common
+// modules use. The test or bench that links them provides the functions.
+
+#include <stdint.h>
+
+#define USB_ENDPOINT_ATTR_BULK 0x02
+
+typedef struct _usbd_device usbd_device;
+
+typedef void (*usbd_endpoint_callback)(usbd_device *usbd_dev, uint8_t ep);
+
+void usbd_ep_setup(usbd_device *usbd_dev, uint8_t addr, uint8_t type, uint16_t max_size,
+                   usbd_endpoint_callback callback);
+uint16_t usbd_ep_write_packet(usbd_device *usbd_dev, uint8_t addr, const void *buf, uint16_t len);
+void usbd_register_sof_callback(usbd_device *usbd_dev, void (*callback)(void));
@@ -0,0 +1,98 @@
+// Block rendering against the per-sample path it replaced: the same note
+// and controller script, stamped against the same fake DAC clock, has to
+// give bit identical output whether it is rendered one frame at a time or
+// in blocks of any size, the DMA half block included.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/synth.c"
+
+#include "check.h"
+
+#define FRAMES (CONTROL_PERIOD * 600)
+#define EVENTS 400
+// Larger than any block, every event is stamped ahead of the render
+#define LATENCY 128
+
+typedef struct ScriptEvent {
+    uint32_t arrival;
+    uint8_t status, data1, data2;
+} ScriptEvent;
+
+static ScriptEvent script[EVENTS];
+static uint32_t now;
+
+static uint32_t fake_clock(void) { return now; }
+
+// Notes, releases, pedal, mod wheel, volume, bend and waveform changes at random frames, in order
+static void make_script(void) {
+    uint32_t i;
+
+    srand(1);
+    for(i = 0; i < EVENTS; i++) {
+        ScriptEvent *e = &script[i];
+        e->arrival = i * (FRAMES - LATENCY) / EVENTS + rand() % 20;
+        e->data1 = 40 + rand() % 24;
+        e->data2 = rand() % 128;
+        switch(rand() % 8) {
+            case 0:
+            case 1:
+            case 2: e->status = 0x90; break;
+            case 3:
+            case 4: e->status = 0x80; break;
+            case 5:
+                e->status = 0xB0;
+                e->data1 = (uint8_t[]){1, 7, 64}[rand() % 3];
+                break;
+            case 6: e->status = 0xE0; break;
+            default:
+                e->status = 0xC0;
+                e->data1 = rand() % OSC_WAVEFORMS;
+                break;
+        }
+    }
+}
+
+// Render everything in chunks of frames, queueing events as they arrive before each chunk
+static void render(uint16_t *out, uint32_t frames) {
+    uint32_t next = 0, chunk;
+
+    synth_init();
+    synth_set_clock(fake_clock, LATENCY);
+    synth_set_knob(3 << 16);
+
+    for(now = 0; now < FRAMES; now += chunk) {
+        chunk = FRAMES - now < frames ? FRAMES - now : frames;
+        for(; next < EVENTS && script[next].arrival < now + chunk; next++) {
+            ScriptEvent *e = &script[next];
+            MidiEvent event = {e->status >> 4, e->status, e->data1, e->data2, 0, 0};
+            uint32_t block_start = now;
+
+            // Arrival time within the chunk, as the DMA interrupt would see it
+            now = e->arrival;
+            synth_queue_event(&event);
+            now = block_start;
+        }
+        synth_render(out + now * 2, chunk);
+    }
+}
+
+int main(void) {
+    static uint16_t per_sample[FRAMES * 2], blocks[FRAMES * 2];
+    static const uint32_t sizes[] = {7, CONTROL_PERIOD, 50, LATENCY};
+    uint32_t i, silent = 0;
+
+    make_script();
+    render(per_sample, 1);
+    // Make sure the script actually plays
+    for(i = 1; i < FRAMES * 2; i++) { silent += per_sample[i] == per_sample[0]; }
+    CHECK(silent < FRAMES);
+
+    for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        render(blocks, sizes[i]);
+        CHECK(memcmp(per_sample, blocks, sizeof(blocks)) == 0);
+    }
+
+    return check_done();
+}
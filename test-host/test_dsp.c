@@ -0,0 +1,83 @@
+// DSP kernels: the dispatching dsp_* functions against the C versions, and
+// both against models of the instructions written from the Armv7-M
+// pseudo-code. On the host dsp_* is the C path. Built for the M4 (with
+// __ARM_FEATURE_DSP) the same source compares the instructions with C.
+
+#include "dsp.h"
+
+#include "check.h"
+
+#define RANDOM_INPUTS 4000000
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// SSAT: clamp to [-2^15, 2^15 - 1]
+static int32_t model_ssat16(int32_t x) {
+    int64_t v = x;
+    return (int32_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+// SMULWB: (SInt(Rn) * SInt(Rm<15:0>))<47:16>, floor division by 2^16
+static int32_t model_smulwb(int32_t a, int32_t b) {
+    int64_t product = (int64_t)a * (int64_t)(int16_t)(uint16_t)b;
+    int64_t q = product / 65536;
+    if(product % 65536 < 0) { q--; }
+    return (int32_t)q;
+}
+
+// SMLAD: product1 + product2 + SInt(Ra), the low 32 bits
+static int32_t model_smlad(uint32_t x, uint32_t y, int32_t acc) {
+    int64_t lo = (int64_t)(int16_t)(x & 0xFFFF) * (int16_t)(y & 0xFFFF);
+    int64_t hi = (int64_t)(int16_t)(x >> 16) * (int16_t)(y >> 16);
+    return (int32_t)(uint32_t)((uint64_t)(lo + hi + acc) & 0xFFFFFFFFu);
+}
+
+// PKHBT with LSL #16: Rn<15:0> in the bottom half, Rm<15:0> in the top
+static uint32_t model_pack16(int32_t lo, int32_t hi) { return ((uint32_t)lo & 0xFFFF) | (((uint32_t)hi & 0xFFFF) << 16); }
+
+static void check_inputs(uint32_t a, uint32_t b, uint32_t c) {
+    int32_t sa = (int32_t)a;
+    int32_t sb = (int32_t)b;
+
+    CHECK_EQ(dsp_ssat16(sa), dsp_ssat16_c(sa));
+    CHECK_EQ(dsp_ssat16_c(sa), model_ssat16(sa));
+
+    CHECK_EQ(dsp_smulwb(sa, sb), dsp_smulwb_c(sa, sb));
+    CHECK_EQ(dsp_smulwb_c(sa, sb), model_smulwb(sa, sb));
+
+    CHECK_EQ(dsp_smlad(a, b, (int32_t)c), dsp_smlad_c(a, b, (int32_t)c));
+    CHECK_EQ(dsp_smlad_c(a, b, (int32_t)c), model_smlad(a, b, (int32_t)c));
+
+    CHECK_EQ(dsp_pack16(sa, sb), dsp_pack16_c(sa, sb));
+    CHECK_EQ(dsp_pack16_c(sa, sb), model_pack16(sa, sb));
+}
+
+int main(void) {
+    static const uint32_t edges[] = {0,          1,          0x7FFF,     0x8000,     0xFFFF,     0x10000,
+                                     0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0xFFFF8000, 0x00018000, 0x80008000,
+                                     0x7FFF7FFF, 0x8000FFFF, 32768 * 3,  0xFFFE0001};
+    const int n = sizeof(edges) / sizeof(edges[0]);
+    int i, j, k;
+
+    for(i = 0; i < n; i++) {
+        for(j = 0; j < n; j++) {
+            for(k = 0; k < n; k++) { check_inputs(edges[i], edges[j], edges[k]); }
+        }
+    }
+
+    for(i = 0; i < RANDOM_INPUTS && check_failures < 20; i++) { check_inputs(rng(), rng(), rng()); }
+
+    // Small values, where the saturation and sign handling switch over
+    for(i = -70000; i <= 70000 && check_failures < 20; i += 7) {
+        check_inputs((uint32_t)i, (uint32_t)i * -3u, (uint32_t)i * 65537u);
+    }
+
+    return check_done();
+}
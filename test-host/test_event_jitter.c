@@ -0,0 +1,122 @@
+// Onset jitter of stamped events. The fake DAC plays the ping-pong buffer
+// the way i2s_spi.c does: both halves are primed at frame 0, and every
+// I2S_BLOCK_FRAMES the half just sent is refilled with the frames one
+// block further on. Note-ons arrive from the USB side at random frames,
+// on and between block boundaries, and are stamped with the DAC position.
+// The onset is the first output frame that isn't silence. Onset minus
+// (arrival + I2S_LATENCY_FRAMES) has to be the same for every note,
+// wherever it arrived within a block. The latency statistic has to agree
+// with when the note is heard, also for events stamped too late to make it.
+
+#include <stdlib.h>
+
+#include "../common/synth.c"
+
+#include "check.h"
+
+// I2S_BLOCK_FRAMES and I2S_LATENCY_FRAMES in i2s_spi.h, which needs libopencm3
+#define BLOCK_FRAMES 32
+#define LATENCY_FRAMES (BLOCK_FRAMES * 2)
+
+#define TRIALS 3000
+#define MAX_ARRIVAL (BLOCK_FRAMES * 20)
+#define PLAYED (MAX_ARRIVAL + LATENCY_FRAMES + BLOCK_FRAMES * 2)
+#define CYCLES_PER_FRAME 1440
+
+// Frames the DAC has sent
+static uint32_t dac_frame;
+
+static uint32_t fake_clock(void) { return dac_frame; }
+
+static uint32_t fake_cycles(void) { return dac_frame * CYCLES_PER_FRAME; }
+
+// Frame the note-on first sounds at, arriving at the given DAC frame
+static uint32_t onset(uint32_t arrival) {
+    static uint16_t out[PLAYED * 2];
+    MidiEvent note = {0x09, 0x90, 69, 127, 0, 0};
+    bool queued = false;
+    uint32_t frame;
+
+    synth_init();
+    synth_set_clock(fake_clock, LATENCY_FRAMES);
+
+    // Prime both halves, then a fill each time a half has been sent
+    dac_frame = 0;
+    synth_render(out, BLOCK_FRAMES * 2);
+    for(dac_frame = BLOCK_FRAMES; dac_frame + BLOCK_FRAMES * 2 <= PLAYED; dac_frame += BLOCK_FRAMES) {
+        // The USB interrupt came in since the last fill
+        if(!queued && arrival <= dac_frame) {
+            uint32_t fill_frame = dac_frame;
+
+            dac_frame = arrival;
+            synth_queue_event(&note);
+            dac_frame = fill_frame;
+            queued = true;
+        }
+        synth_render(out + (dac_frame + BLOCK_FRAMES) * 2, BLOCK_FRAMES);
+    }
+
+    for(frame = 0; frame < PLAYED; frame++) {
+        if(out[frame * 2] != out[0] || out[frame * 2 + 1] != out[1]) { return frame; }
+    }
+    return UINT32_MAX;
+}
+
+// latency_last for a note stamped with the given latency, arriving at frame 0
+// right after the priming. The first fill renders frames 64 to 95.
+static uint32_t measured_latency(uint32_t latency) {
+    static uint16_t out[BLOCK_FRAMES * 2 * 2];
+    MidiEvent note = {0x09, 0x90, 69, 127, 0, 0};
+    SynthStats stats;
+
+    synth_init();
+    synth_set_clock(fake_clock, latency);
+    synth_set_cycle_counter(fake_cycles, CYCLES_PER_FRAME);
+    dac_frame = 0;
+    synth_render(out, BLOCK_FRAMES * 2);
+    synth_queue_event(&note);
+    for(dac_frame = BLOCK_FRAMES; dac_frame <= BLOCK_FRAMES * 3; dac_frame += BLOCK_FRAMES) {
+        synth_render(out, BLOCK_FRAMES);
+    }
+
+    synth_get_stats(&stats);
+    return stats.latency_last;
+}
+
+static void test_latency_stat(void) {
+    // On time and later it is the stamp, too short a latency plays at frame 64 all the same
+    CHECK_EQ(measured_latency(LATENCY_FRAMES), LATENCY_FRAMES * CYCLES_PER_FRAME);
+    CHECK_EQ(measured_latency(LATENCY_FRAMES + 20), (LATENCY_FRAMES + 20) * CYCLES_PER_FRAME);
+    CHECK_EQ(measured_latency(0), LATENCY_FRAMES * CYCLES_PER_FRAME);
+    CHECK_EQ(measured_latency(BLOCK_FRAMES / 2), LATENCY_FRAMES * CYCLES_PER_FRAME);
+}
+
+int main(void) {
+    uint32_t histogram[BLOCK_FRAMES * 2] = {0};
+    int32_t delay, min = INT32_MAX, max = INT32_MIN;
+    uint32_t trial, arrival;
+
+    srand(1);
+    for(trial = 0; trial < TRIALS; trial++) {
+        // Every position within a block, the boundaries included
+        arrival = trial < BLOCK_FRAMES * 4 ? BLOCK_FRAMES + trial : (uint32_t)rand() % MAX_ARRIVAL;
+        delay = (int32_t)(onset(arrival) - (arrival + LATENCY_FRAMES));
+        if(delay < min) { min = delay; }
+        if(delay > max) { max = delay; }
+        if(delay >= 0 && delay < BLOCK_FRAMES * 2) { histogram[delay]++; }
+    }
+
+    printf("onset - (arrival + %u) over %u notes: %d to %d frames", LATENCY_FRAMES, TRIALS, min, max);
+    for(delay = 0; delay < BLOCK_FRAMES * 2; delay++) {
+        if(histogram[delay]) { printf(", %d: %u", delay, histogram[delay]); }
+    }
+    printf("\n");
+
+    // A single value, and the note sounds no later than its stamped frame's next sample
+    CHECK_EQ(min, max);
+    CHECK(min >= 0 && max <= 1);
+
+    test_latency_stat();
+
+    return check_done();
+}
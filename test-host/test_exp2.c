@@ -0,0 +1,93 @@
+// Accuracy of the fixed point exp2 and log2 in tools.c against libm, in
+// cents. Pitch is what these are for, so exp2 is checked on the notes from
+// A4 up, where the s15.16 result has the resolution to show the table
+// error; below that the output rounding dominates. log2 is checked over
+// the whole input range, down to the inputs below 1.0.
+
+#include <math.h>
+
+#include "check.h"
+#include "tools.h"
+
+// Largest interpolation error allowed per table size, a bit above what it gives
+#if EXP2_LUT_BITS == 4
+#define EXP2_LUT_CENTS 0.45
+#define LOG2_LUT_CENTS 0.85
+#elif EXP2_LUT_BITS == 6
+#define EXP2_LUT_CENTS 0.04
+#define LOG2_LUT_CENTS 0.07
+#else
+#define EXP2_LUT_CENTS 0.015
+#define LOG2_LUT_CENTS 0.025
+#endif
+
+#define EXP2_POLY_CENTS 0.16
+
+static double exp2_cents(int32_t result, int32_t a) { return fabs(1200 * log2(result / 65536.0 / exp2(a / 65536.0))); }
+
+static void test_exp2(void) {
+    double all_lut = 0, all_poly = 0, lut = 0, poly = 0, error;
+    int32_t a;
+    int note;
+
+    for(note = 0; note < 128; note++) {
+        a = (note - 69) * 65536 / 12;
+
+        error = exp2_cents(fixed_exp2_lut(a), a);
+        if(error > all_lut) { all_lut = error; }
+        if(note >= 69 && error > lut) { lut = error; }
+
+        error = exp2_cents(fixed_exp2(a), a);
+        if(error > all_poly) { all_poly = error; }
+        if(note >= 69 && error > poly) { poly = error; }
+    }
+
+    printf("exp2 max error, all notes / from A4: LUT %d bits %.3f / %.3f cents, polynomial %.3f / %.3f cents\n",
+           EXP2_LUT_BITS, all_lut, lut, all_poly, poly);
+    CHECK(lut <= EXP2_LUT_CENTS);
+    CHECK(poly <= EXP2_POLY_CENTS);
+
+    // Whole octaves come out exact
+    CHECK_EQ(fixed_exp2_lut(0), 65536);
+    CHECK_EQ(fixed_exp2_lut(5 * 65536), 32 * 65536);
+    CHECK_EQ(fixed_exp2_lut(-4 * 65536), 4096);
+
+    // The top octave of the range, where the Q30 mantissa is the result
+    error = 0;
+    for(a = 14 * 65536; a < 15 * 65536; a += 97) {
+        double e = exp2_cents(fixed_exp2_lut(a), a);
+        if(e > error) { error = e; }
+    }
+    CHECK(error <= EXP2_LUT_CENTS);
+    CHECK_EQ(fixed_exp2_lut(14 * 65536), 16384 * 65536);
+    CHECK(fixed_exp2_lut(15 * 65536 - 1) > fixed_exp2_lut(15 * 65536 - 65536 / 12));
+}
+
+static void test_log2(void) {
+    double max = 0, error;
+    int32_t previous = INT32_MIN, result;
+    uint64_t a;
+    int n;
+
+    // Exact at powers of two, including the negative results below 1.0
+    for(n = 0; n < 32; n++) { CHECK_EQ(fixed_log2_lut(1u << n), (n - 16) * 65536); }
+    CHECK_EQ(fixed_log2_lut(0), INT32_MIN);
+
+    for(a = 1; a <= UINT32_MAX; a += (a >> 12) + 1) {
+        result = fixed_log2_lut(a);
+        error = fabs(result / 65536.0 - log2(a / 65536.0)) * 1200;
+        if(error > max) { max = error; }
+        CHECK(result >= previous);
+        previous = result;
+    }
+
+    printf("log2 max error: LUT %d bits %.3f cents\n", EXP2_LUT_BITS, max);
+    CHECK(max <= LOG2_LUT_CENTS);
+}
+
+int main(void) {
+    test_exp2();
+    test_log2();
+
+    return check_done();
+}
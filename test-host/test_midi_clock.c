@@ -0,0 +1,148 @@
+// MIDI clock follower on jittered tick streams: how many ticks until the
+// tempo settles after a start or a tempo change, and how far tempo and
+// beat position are off once it has. Ticks are sent on time plus uniform
+// jitter, optionally delivered on 1 ms USB frames.
+
+#include <math.h>
+
+#include "check.h"
+#include "midi_clock.h"
+
+#define RATE 50000
+#define BEATS 64
+
+// A tempo counts as settled within this many BPM
+#define SETTLED_BPM 0.5
+
+typedef struct Stream {
+    double bpm;
+    // Tempo from the middle of the stream on
+    double bpm2;
+    double jitter_ms;
+    bool usb_frames;
+    // Limits the run is checked against
+    int max_lock_ticks;
+    double max_tempo_error;
+    double max_phase_error;
+} Stream;
+
+static uint32_t rng_state = 0x9E3779B9;
+
+static double urand(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state / 4294967296.0;
+}
+
+static void run(const Stream *stream) {
+    const int change = BEATS / 2 * MIDI_CLOCK_PPQN;
+    double period = RATE * 60.0 / (stream->bpm * MIDI_CLOCK_PPQN);
+    double t = 1000;
+    double tempo_max = 0, tempo_sum = 0, phase_max = 0;
+    int lock_ticks[2] = {0, 0};
+    int n = 0, k;
+    MidiClock clock;
+
+    midi_clock_init(&clock);
+    midi_clock_start(&clock);
+
+    for(k = 0; k < BEATS * MIDI_CLOCK_PPQN; k++) {
+        int segment = k >= change;
+        double bpm = segment ? stream->bpm2 : stream->bpm;
+        double arrival = t + urand() * stream->jitter_ms * RATE / 1000;
+        double tempo_error, phase_error;
+
+        if(k == change) { period = RATE * 60.0 / (stream->bpm2 * MIDI_CLOCK_PPQN); }
+        if(stream->usb_frames) { arrival = ceil(arrival / (RATE / 1000.0)) * (RATE / 1000.0); }
+        midi_clock_tick(&clock, (uint32_t)arrival);
+
+        // The last tick where the tempo was still off, counted from the start of the segment
+        tempo_error = fabs(midi_clock_tempo(&clock, RATE) / 256.0 - bpm);
+        if(tempo_error > SETTLED_BPM) { lock_ticks[segment] = k - segment * change + 1; }
+
+        // Past the settling time, the tempo and the beat position half way to the next tick
+        if(k - segment * change >= stream->max_lock_ticks) {
+            phase_error = fabs(midi_clock_position(&clock, (uint32_t)(t + period / 2)) / 65536.0 -
+                               (k + 0.5) / MIDI_CLOCK_PPQN) * MIDI_CLOCK_PPQN;
+            if(tempo_error > tempo_max) { tempo_max = tempo_error; }
+            if(phase_error > phase_max) { phase_max = phase_error; }
+            tempo_sum += tempo_error;
+            n++;
+        }
+        t += period;
+    }
+
+    printf("%5.1f -> %5.1f BPM, %.1f ms jitter%s: locked after %d / %d ticks, tempo error mean %.3f max %.3f BPM, "
+           "phase error max %.3f ticks\n",
+           stream->bpm, stream->bpm2, stream->jitter_ms, stream->usb_frames ? ", 1 ms frames" : "", lock_ticks[0],
+           lock_ticks[1], tempo_sum / n, tempo_max, phase_max);
+
+    CHECK(lock_ticks[0] <= stream->max_lock_ticks);
+    CHECK(lock_ticks[1] <= stream->max_lock_ticks);
+    CHECK(tempo_max <= stream->max_tempo_error);
+    CHECK(phase_max <= stream->max_phase_error);
+}
+
+// Transport handling on a clean stream
+static void test_transport(void) {
+    MidiClock clock;
+    int k;
+
+    midi_clock_init(&clock);
+    CHECK(!midi_clock_locked(&clock));
+    CHECK_EQ(midi_clock_tempo(&clock, RATE), 0);
+
+    // 1000 frames per tick is 125 BPM
+    midi_clock_start(&clock);
+    midi_clock_tick(&clock, 0);
+    CHECK(!midi_clock_locked(&clock));
+    // The first tick after start is position 0
+    CHECK_EQ(clock.position, 0);
+    midi_clock_tick(&clock, 1000);
+    CHECK(midi_clock_locked(&clock));
+    CHECK_EQ(midi_clock_tempo(&clock, RATE), 125 * 256);
+
+    // Half way between ticks 1 and 2, and never past the next tick
+    CHECK_EQ(midi_clock_position(&clock, 1500), (uint32_t)(1.5 * 65536 / MIDI_CLOCK_PPQN));
+    CHECK_EQ(midi_clock_position(&clock, 5000), (2 * 65536 - 1) / MIDI_CLOCK_PPQN);
+
+    // Stop freezes the position, the tempo keeps following
+    midi_clock_stop(&clock);
+    for(k = 2; k < 10; k++) { midi_clock_tick(&clock, k * 1000); }
+    CHECK_EQ(clock.position, 1);
+    CHECK_EQ(midi_clock_position(&clock, 9500), 65536 / MIDI_CLOCK_PPQN);
+    midi_clock_continue(&clock);
+    midi_clock_tick(&clock, 10000);
+    CHECK_EQ(clock.position, 2);
+
+    // Song position in sixteenths, the next tick lands on it
+    midi_clock_song_position(&clock, 8);
+    midi_clock_tick(&clock, 11000);
+    CHECK_EQ(clock.position, 8 * MIDI_CLOCK_PPQN / 4);
+    CHECK_EQ(midi_clock_position(&clock, 11000), 2 * 65536);
+
+    // A dropped tick restarts the period estimate from the next one
+    midi_clock_tick(&clock, 13000);
+    CHECK(!midi_clock_locked(&clock));
+    midi_clock_tick(&clock, 14000);
+    CHECK(midi_clock_locked(&clock));
+    CHECK_EQ(midi_clock_tempo(&clock, RATE), 125 * 256);
+}
+
+int main(void) {
+    static const Stream streams[] = {
+        // Frames are whole numbers, a 1041.67 frame period reads as 1041 at first
+        {120, 120, 0, false, 2, 0.1, 0.01},
+        {120, 120, 1, false, 48, 0.2, 0.1},
+        {120, 140, 1, true, 48, 0.3, 0.15},
+        {90, 174, 2, true, 72, 0.8, 0.3},
+        {60, 60, 1, true, 48, 0.1, 0.1},
+    };
+    unsigned i;
+
+    test_transport();
+    for(i = 0; i < sizeof(streams) / sizeof(streams[0]); i++) { run(&streams[i]); }
+
+    return check_done();
+}
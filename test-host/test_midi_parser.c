@@ -0,0 +1,318 @@
+// USB-MIDI packet decoding and the raw byte stream parser: every code
+// index number, padding and truncated transfers, running status,
+// real-time bytes inside messages and SysEx, and a randomised round trip
+// from messages to bytes to event packets and back.
+
+#include <string.h>
+
+#include "check.h"
+#include "midi_stream.h"
+
+#define MAX_EVENTS 4096
+
+static MidiEvent events[MAX_EVENTS];
+static uint32_t event_count;
+
+static void collect(const MidiEvent *event) {
+    if(event_count < MAX_EVENTS) { events[event_count] = *event; }
+    event_count++;
+}
+
+static void check_event(uint32_t i, uint8_t header, uint8_t status, uint8_t data1, uint8_t data2) {
+    CHECK(i < event_count);
+    if(i >= event_count) { return; }
+    CHECK_EQ(events[i].header, header);
+    CHECK_EQ(events[i].status, status);
+    CHECK_EQ(events[i].data1, data1);
+    CHECK_EQ(events[i].data2, data2);
+}
+
+static void stream_bytes(MidiStream *stream, const uint8_t *bytes, uint32_t len) {
+    event_count = 0;
+    midi_stream_parse(stream, bytes, len, collect);
+}
+
+static void test_usb_cins(void) {
+    // One packet per code index number, cable 3
+    static const uint8_t packets[16][4] = {
+        {0x30, 0x12, 0x34, 0x56}, {0x31, 0x12, 0x34, 0x56}, {0x32, 0xF1, 0x12, 0x00}, {0x33, 0xF2, 0x12, 0x34},
+        {0x34, 0xF0, 0x7E, 0x00}, {0x35, 0xF7, 0x00, 0x00}, {0x36, 0x01, 0xF7, 0x00}, {0x37, 0x01, 0x02, 0xF7},
+        {0x38, 0x81, 0x3C, 0x40}, {0x39, 0x92, 0x3C, 0x64}, {0x3A, 0xA3, 0x3C, 0x20}, {0x3B, 0xB4, 0x07, 0x7F},
+        {0x3C, 0xC5, 0x05, 0x00}, {0x3D, 0xD6, 0x30, 0x00}, {0x3E, 0xE7, 0x00, 0x40}, {0x3F, 0xF8, 0x00, 0x00},
+    };
+    static const uint8_t lengths[16] = {0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1};
+    MidiEvent event;
+    int cin;
+
+    for(cin = 0; cin < 16; cin++) {
+        CHECK_EQ(midi_usb_cin_length(cin), lengths[cin]);
+        memset(&event, 0xAA, sizeof(event));
+        // 0x0 and 0x1 are reserved, everything else decodes as it is
+        CHECK_EQ(midi_usb_decode(packets[cin], &event), cin >= 2);
+        if(cin < 2) { continue; }
+        CHECK_EQ(event.header, packets[cin][0]);
+        CHECK_EQ(event.status, packets[cin][1]);
+        CHECK_EQ(event.data1, packets[cin][2]);
+        CHECK_EQ(event.data2, packets[cin][3]);
+        CHECK_EQ(event.time, 0);
+        CHECK_EQ(event.arrival, 0);
+    }
+
+    // Channel voice: the status has to match the CIN, data bytes lose bit 7
+    CHECK(!midi_usb_decode((const uint8_t[]){0x09, 0x80, 0x3C, 0x40}, &event));
+    CHECK(!midi_usb_decode((const uint8_t[]){0x0B, 0x3C, 0x40, 0x00}, &event));
+    CHECK(midi_usb_decode((const uint8_t[]){0x09, 0x90, 0xBC, 0xC0}, &event));
+    CHECK_EQ(event.data1, 0x3C);
+    CHECK_EQ(event.data2, 0x40);
+}
+
+static void test_usb_parse(void) {
+    static const uint8_t transfer[] = {
+        0x09, 0x90, 0x3C, 0x64,  // note on
+        0x00, 0x00, 0x00, 0x00,  // padding
+        0x1F, 0xF8, 0x00, 0x00,  // clock on cable 1
+        0x04, 0xF0, 0x7E, 0x7F,  // SysEx start
+        0x07, 0x06, 0x01, 0xF7,  // SysEx end
+        0x09, 0xA0, 0x3C, 0x64,  // CIN does not match, skipped
+        0x08, 0x80, 0x3C, 0x00,  // note off
+        0x0B, 0xB0, 0x07,        // truncated
+    };
+
+    event_count = 0;
+    CHECK_EQ(midi_usb_parse(transfer, sizeof(transfer), collect), 5);
+    CHECK_EQ(event_count, 5);
+    check_event(0, 0x09, 0x90, 0x3C, 0x64);
+    check_event(1, 0x1F, 0xF8, 0x00, 0x00);
+    check_event(2, 0x04, 0xF0, 0x7E, 0x7F);
+    check_event(3, 0x07, 0x06, 0x01, 0xF7);
+    check_event(4, 0x08, 0x80, 0x3C, 0x00);
+
+    // Less than a packet is nothing
+    event_count = 0;
+    CHECK_EQ(midi_usb_parse(transfer, 3, collect), 0);
+    CHECK_EQ(midi_usb_parse(transfer, 0, collect), 0);
+    CHECK_EQ(event_count, 0);
+}
+
+static void test_stream_running_status(void) {
+    static const uint8_t bytes[] = {0x90, 60, 100, 62, 90, 64, 0, 0xC3, 5, 6, 0xE0, 0x00, 0x40, 0x01};
+    MidiStream stream;
+
+    midi_stream_init(&stream, 2);
+    stream_bytes(&stream, bytes, sizeof(bytes));
+    CHECK_EQ(event_count, 6);
+    check_event(0, 0x29, 0x90, 60, 100);
+    check_event(1, 0x29, 0x90, 62, 90);
+    check_event(2, 0x29, 0x90, 64, 0);
+    check_event(3, 0x2C, 0xC3, 5, 0);
+    check_event(4, 0x2C, 0xC3, 6, 0);
+    check_event(5, 0x2E, 0xE0, 0x00, 0x40);
+
+    // The second pitch bend is still waiting on its second data byte
+    stream_bytes(&stream, (const uint8_t[]){0x60}, 1);
+    CHECK_EQ(event_count, 1);
+    check_event(0, 0x2E, 0xE0, 0x01, 0x60);
+}
+
+static void test_stream_realtime(void) {
+    // Clock and active sensing in the middle of a note on and a CC
+    static const uint8_t bytes[] = {0x90, 0xF8, 60, 0xFE, 100, 0xB0, 7, 0xFA, 127, 0xFF};
+    MidiStream stream;
+
+    midi_stream_init(&stream, 0);
+    stream_bytes(&stream, bytes, sizeof(bytes));
+    CHECK_EQ(event_count, 6);
+    check_event(0, 0x0F, 0xF8, 0, 0);
+    check_event(1, 0x0F, 0xFE, 0, 0);
+    check_event(2, 0x09, 0x90, 60, 100);
+    check_event(3, 0x0F, 0xFA, 0, 0);
+    check_event(4, 0x0B, 0xB0, 7, 127);
+    check_event(5, 0x0F, 0xFF, 0, 0);
+}
+
+static void test_stream_system_common(void) {
+    // Song position, song select, MTC quarter frame, tune request, undefined
+    // 0xF4 and a stray 0xF7; system common cancels running status
+    static const uint8_t bytes[] = {0x90, 60, 100, 0xF2, 0x10, 0x20, 61, 0xF3, 5, 0xF1, 0x33, 0xF6, 0xF4, 1, 0xF7, 2};
+    MidiStream stream;
+
+    midi_stream_init(&stream, 0);
+    stream_bytes(&stream, bytes, sizeof(bytes));
+    CHECK_EQ(event_count, 5);
+    check_event(0, 0x09, 0x90, 60, 100);
+    check_event(1, 0x03, 0xF2, 0x10, 0x20);
+    check_event(2, 0x02, 0xF3, 5, 0);
+    check_event(3, 0x02, 0xF1, 0x33, 0);
+    check_event(4, 0x05, 0xF6, 0, 0);
+}
+
+static void test_stream_sysex(void) {
+    MidiStream stream;
+
+    midi_stream_init(&stream, 1);
+
+    // End packets with one, two and three bytes, real-time bytes in between
+    stream_bytes(&stream, (const uint8_t[]){0xF0, 0x7E, 0xF8, 0x00, 0x06, 0xFE, 0x01, 0xF7}, 8);
+    CHECK_EQ(event_count, 4);
+    check_event(0, 0x1F, 0xF8, 0, 0);
+    check_event(1, 0x14, 0xF0, 0x7E, 0x00);
+    check_event(2, 0x1F, 0xFE, 0, 0);
+    check_event(3, 0x17, 0x06, 0x01, 0xF7);
+
+    stream_bytes(&stream, (const uint8_t[]){0xF0, 1, 2, 3, 0xF7}, 5);
+    CHECK_EQ(event_count, 2);
+    check_event(0, 0x14, 0xF0, 1, 2);
+    check_event(1, 0x16, 3, 0xF7, 0);
+
+    stream_bytes(&stream, (const uint8_t[]){0xF0, 1, 0xF7}, 3);
+    CHECK_EQ(event_count, 1);
+    check_event(0, 0x17, 0xF0, 1, 0xF7);
+
+    stream_bytes(&stream, (const uint8_t[]){0xF0, 0xF7}, 2);
+    CHECK_EQ(event_count, 1);
+    check_event(0, 0x16, 0xF0, 0xF7, 0);
+
+    stream_bytes(&stream, (const uint8_t[]){0xF0, 1, 2, 0xF7}, 4);
+    CHECK_EQ(event_count, 2);
+    check_event(0, 0x14, 0xF0, 1, 2);
+    check_event(1, 0x15, 0xF7, 0, 0);
+
+    // Split across calls
+    stream_bytes(&stream, (const uint8_t[]){0xF0, 1}, 2);
+    CHECK_EQ(event_count, 0);
+    stream_bytes(&stream, (const uint8_t[]){2, 3, 0xF7}, 3);
+    CHECK_EQ(event_count, 2);
+
+    // A status byte ends a truncated SysEx, the rest is dropped and the note goes through
+    stream_bytes(&stream, (const uint8_t[]){0xF0, 1, 2, 3, 4, 0x90, 60, 100, 5, 0xF7}, 10);
+    CHECK_EQ(event_count, 2);
+    check_event(0, 0x14, 0xF0, 1, 2);
+    check_event(1, 0x19, 0x90, 60, 100);
+}
+
+static void test_stream_truncated(void) {
+    MidiStream stream;
+
+    midi_stream_init(&stream, 0);
+
+    // Data before any status is ignored
+    stream_bytes(&stream, (const uint8_t[]){60, 100, 0x80, 60, 0}, 5);
+    CHECK_EQ(event_count, 1);
+    check_event(0, 0x08, 0x80, 60, 0);
+
+    // A new status drops the half message before it
+    stream_bytes(&stream, (const uint8_t[]){0x90, 60, 0xB0, 1, 64, 0xF2, 3, 0xC0, 9}, 9);
+    CHECK_EQ(event_count, 2);
+    check_event(0, 0x0B, 0xB0, 1, 64);
+    check_event(1, 0x0C, 0xC0, 9, 0);
+
+    // No running status after system common, the data is dropped
+    stream_bytes(&stream, (const uint8_t[]){0xF3, 1, 2}, 3);
+    CHECK_EQ(event_count, 1);
+    check_event(0, 0x02, 0xF3, 1, 0);
+}
+
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Random messages sent with running status and real-time bytes sprinkled
+// in, the event packets turned back into bytes have to give the messages
+// again, with the real-time bytes in their own order
+static void test_stream_round_trip(void) {
+    static uint8_t messages[MAX_EVENTS], wire[MAX_EVENTS * 2], decoded[MAX_EVENTS], realtime[MAX_EVENTS],
+        decoded_realtime[MAX_EVENTS];
+    uint32_t message_len = 0, wire_len = 0, decoded_len = 0, realtime_len = 0, decoded_realtime_len = 0;
+    uint8_t running = 0;
+    MidiStream stream;
+    uint32_t i, j;
+    int round;
+
+    for(round = 0; round < 200; round++) {
+        message_len = wire_len = decoded_len = realtime_len = decoded_realtime_len = 0;
+        running = 0;
+
+        while(message_len < MAX_EVENTS - 64) {
+            uint8_t message[40];
+            uint32_t length, kind = rng() % 8;
+
+            if(kind < 5) {
+                // Channel voice
+                message[0] = 0x80 + (rng() % 7) * 0x10 + rng() % 2;
+                length = (message[0] & 0xE0) == 0xC0 ? 2 : 3;
+            } else if(kind < 7) {
+                message[0] = 0xF0;
+                length = 2 + rng() % 30;
+            } else {
+                static const uint8_t common[] = {0xF1, 0xF2, 0xF3, 0xF6};
+                static const uint8_t common_lengths[] = {2, 3, 2, 1};
+                j = rng() % 4;
+                message[0] = common[j];
+                length = common_lengths[j];
+            }
+            for(j = 1; j < length; j++) { message[j] = rng() & 0x7F; }
+            if(message[0] == 0xF0) { message[length - 1] = 0xF7; }
+
+            memcpy(&messages[message_len], message, length);
+            message_len += length;
+
+            for(j = 0; j < length; j++) {
+                // Running status leaves out a repeated channel status
+                if(j == 0 && message[0] == running) { continue; }
+                if(rng() % 8 == 0) {
+                    realtime[realtime_len] = 0xF8 + rng() % 8;
+                    // 0xF9 and 0xFD are undefined but still real-time
+                    wire[wire_len++] = realtime[realtime_len++];
+                }
+                wire[wire_len++] = message[j];
+            }
+            running = message[0] < 0xF0 ? message[0] : 0;
+        }
+
+        midi_stream_init(&stream, 5);
+        event_count = 0;
+        // Fed in random sized pieces
+        for(i = 0; i < wire_len; i += j) {
+            j = 1 + rng() % 7;
+            if(j > wire_len - i) { j = wire_len - i; }
+            midi_stream_parse(&stream, &wire[i], j, collect);
+        }
+        CHECK(event_count <= MAX_EVENTS);
+
+        for(i = 0; i < event_count && i < MAX_EVENTS; i++) {
+            const uint8_t bytes[3] = {events[i].status, events[i].data1, events[i].data2};
+            uint8_t cin = events[i].header & 0x0F;
+
+            CHECK_EQ(events[i].header >> 4, 5);
+            if(cin == 0xF && bytes[0] >= 0xF8) {
+                decoded_realtime[decoded_realtime_len++] = bytes[0];
+                continue;
+            }
+            for(j = 0; j < midi_usb_cin_length(cin); j++) { decoded[decoded_len++] = bytes[j]; }
+        }
+
+        CHECK_EQ(decoded_len, message_len);
+        CHECK(memcmp(decoded, messages, message_len) == 0);
+        CHECK_EQ(decoded_realtime_len, realtime_len);
+        CHECK(memcmp(decoded_realtime, realtime, realtime_len) == 0);
+        if(check_failures) { break; }
+    }
+}
+
+int main(void) {
+    test_usb_cins();
+    test_usb_parse();
+    test_stream_running_status();
+    test_stream_realtime();
+    test_stream_system_common();
+    test_stream_sysex();
+    test_stream_truncated();
+    test_stream_round_trip();
+
+    return check_done();
+}
@@ -0,0 +1,105 @@
+// MIDI queue under two threads: a producer pushing numbered events as fast
+// as it can, retrying when the ring is full, and a consumer popping and
+// peeking. Every event has to arrive exactly once, in order and whole.
+// x86 is strongly ordered, so this mostly catches compiler reordering; run
+// it on an ARM host or with -fsanitize=thread to cover the memory model.
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "check.h"
+#include "midi_queue.h"
+
+#define EVENTS 1000000u
+
+static MidiQueue queue;
+static uint32_t refused;
+// Set when the consumer gives up, so the producer doesn't wait on a full ring forever
+static bool consumer_stopped;
+
+// Every field derived from the sequence number, so a torn slot shows up
+static MidiEvent make_event(uint32_t seq) {
+    MidiEvent event = {(uint8_t)seq, (uint8_t)(seq >> 8), (uint8_t)(seq >> 16), (uint8_t)(seq >> 24), seq,
+                       seq * 2654435761u};
+    return event;
+}
+
+static bool same_event(const MidiEvent *a, const MidiEvent *b) {
+    return a->header == b->header && a->status == b->status && a->data1 == b->data1 && a->data2 == b->data2 &&
+           a->time == b->time && a->arrival == b->arrival;
+}
+
+static void *producer(void *arg) {
+    uint32_t seq;
+
+    (void)arg;
+    for(seq = 0; seq < EVENTS; seq++) {
+        MidiEvent event = make_event(seq);
+        // Yield rather than spin, the test host may have a single core
+        while(!midi_queue_push(&queue, &event)) {
+            if(__atomic_load_n(&consumer_stopped, __ATOMIC_RELAXED)) { return NULL; }
+            refused++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    uint32_t expected = 0;
+    uint32_t errors = 0;
+
+    (void)arg;
+    while(expected < EVENTS && errors < 20) {
+        MidiEvent want = make_event(expected);
+        MidiEvent got;
+
+        // Every other event through peek first, like the synth does
+        if(expected & 1) {
+            const MidiEvent *next = midi_queue_peek(&queue);
+            if(next == NULL) {
+                sched_yield();
+                continue;
+            }
+            if(!same_event(next, &want)) {
+                CHECK_EQ(next->time, want.time);
+                errors++;
+            }
+        }
+        if(!midi_queue_pop(&queue, &got)) {
+            // Peek saw the event, so pop must not fail
+            CHECK(!(expected & 1));
+            sched_yield();
+            continue;
+        }
+        if(!same_event(&got, &want)) {
+            CHECK_EQ(got.time, want.time);
+            errors++;
+        }
+        expected++;
+    }
+    __atomic_store_n(&consumer_stopped, true, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+int main(void) {
+    pthread_t threads[2];
+    MidiEvent event;
+
+    midi_queue_init(&queue);
+    pthread_create(&threads[1], NULL, consumer, NULL);
+    pthread_create(&threads[0], NULL, producer, NULL);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+
+    // Nothing left over, and the statistics match what the producer saw
+    if(check_failures) { return check_done(); }
+    CHECK(!midi_queue_pop(&queue, &event));
+    CHECK_EQ(midi_queue_depth(&queue), 0);
+    CHECK_EQ(queue.head, EVENTS);
+    CHECK_EQ(queue.overflows, refused);
+    CHECK(queue.max_depth >= 1 && queue.max_depth <= MIDI_QUEUE_SIZE);
+    printf("%u events, %u refused pushes, max depth %u\n", EVENTS, refused, queue.max_depth);
+
+    return check_done();
+}
@@ -0,0 +1,90 @@
+// The F0 7D 02 stats reply, decoded the way a host tool would from the
+// layout documented in midi_stats.h, so the encoder and the comment can't
+// drift apart.
+
+#include "check.h"
+#include "midi_queue.h"
+#include "midi_stats.h"
+
+// One 32-bit value from five 7-bit bytes, least significant first
+static uint32_t decode_value(const uint8_t *bytes) {
+    uint32_t value = 0;
+    int i;
+
+    for(i = 4; i >= 0; i--) { value = (value << 7) | bytes[i]; }
+    return value;
+}
+
+static void test_layout(void) {
+    uint8_t reply[MIDI_STATS_REPLY_SIZE + 1];
+    MidiStatsReport report;
+    uint32_t seed = 0x9E3779B9;
+    uint32_t *fields[MIDI_STATS_VALUES];
+    uint32_t n = 0, len, i;
+
+    // The documented order, by name
+    for(i = 0; i < 16; i++) { fields[n++] = &report.midi.events[i]; }
+    fields[n++] = &report.midi.total;
+    fields[n++] = &report.queue_overflows;
+    fields[n++] = &report.queue_max_depth;
+    fields[n++] = &report.latency_last;
+    fields[n++] = &report.latency_max;
+    fields[n++] = &report.latency_average;
+    fields[n++] = &report.sysex_overflows;
+    fields[n++] = &report.sysex_dropped;
+    fields[n++] = &report.sysex_unhandled;
+    fields[n++] = &report.tx_overflows;
+    fields[n++] = &report.fill_cycles_max;
+    fields[n++] = &report.voice_limit;
+    fields[n++] = &report.voice_cycles;
+    CHECK_EQ(n, MIDI_STATS_VALUES);
+    // A field added to the struct has to be in the count and the reply
+    CHECK_EQ(sizeof(report), MIDI_STATS_VALUES * sizeof(uint32_t));
+
+    // Every field different, all 32 bits in use, and the extremes
+    for(i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        *fields[i] = seed;
+    }
+    report.midi.events[0] = 0;
+    report.midi.events[1] = UINT32_MAX;
+    report.voice_cycles = 0x80000000u;
+
+    reply[MIDI_STATS_REPLY_SIZE] = 0xAA;
+    len = midi_stats_reply(&report, reply);
+    CHECK_EQ(len, MIDI_STATS_REPLY_SIZE);
+    CHECK_EQ(reply[MIDI_STATS_REPLY_SIZE], 0xAA);
+
+    CHECK_EQ(reply[0], 0xF0);
+    CHECK_EQ(reply[1], 0x7D);
+    CHECK_EQ(reply[2], 0x02);
+    CHECK_EQ(reply[len - 1], 0xF7);
+    for(i = 1; i < len - 1; i++) { CHECK(reply[i] < 0x80); }
+
+    for(i = 0; i < n; i++) { CHECK_EQ(decode_value(&reply[3 + i * 5]), *fields[i]); }
+
+    // midi_tx_sysex takes a message only if all of its packets fit in the ring
+    CHECK((MIDI_STATS_REPLY_SIZE + 2) / 3 <= MIDI_QUEUE_SIZE);
+}
+
+static void test_count(void) {
+    MidiStats stats;
+    MidiEvent note = {0x29, 0x90, 60, 100, 0, 0};
+    MidiEvent clock = {0x0F, 0xF8, 0, 0, 0, 0};
+
+    midi_stats_init(&stats);
+    midi_stats_count(&stats, &note);
+    midi_stats_count(&stats, &note);
+    midi_stats_count(&stats, &clock);
+    // By code index number, the cable doesn't matter
+    CHECK_EQ(stats.events[0x9], 2);
+    CHECK_EQ(stats.events[0xF], 1);
+    CHECK_EQ(stats.total, 3);
+}
+
+int main(void) {
+    test_layout();
+    test_count();
+
+    return check_done();
+}
@@ -0,0 +1,43 @@
+// Cached phase increments against the per-sample formula they replaced:
+// phase += 440 * fixed_exp2(((note << 16) + detune) / 12), note relative to A4.
+// Includes synth.c to get at the table and the voice state.
+
+#include "../common/synth.c"
+
+#include "check.h"
+
+static uint32_t formula(int16_t note, int32_t note_detune) { return 440 * fixed_exp2((note * 65536 + note_detune) / 12); }
+
+int main(void) {
+    static const int32_t detunes[] = {0, 1, -1, 16, -16, 4095, -4096, 32767, -32768, 65536, -65536};
+    uint16_t out[CONTROL_PERIOD * 2];
+    int note, d, i;
+
+    // The table holds the formula for every MIDI note, bit for bit
+    for(note = 0; note < 128; note++) { CHECK_EQ(note_increments[note], formula(note - 69, 0)); }
+
+    // Detuned notes go through the formula itself, undetuned ones through the table
+    for(note = 0; note < 128; note++) {
+        for(d = 0; d < (int)(sizeof(detunes) / sizeof(detunes[0])); d++) {
+            CHECK_EQ(note_increment(note - 69, detunes[d]), formula(note - 69, detunes[d]));
+        }
+    }
+
+    // Cached on note-on with the knob detune in place, then a single add per frame
+    synth_init();
+    synth_set_knob(123);
+    for(i = 0; i < 2000 && knob_detune != knob_target; i++) { synth_render(out, CONTROL_PERIOD); }
+    CHECK_EQ(knob_detune, 123 * 16);
+
+    for(i = 0; i < SYNTH_VOICES; i++) { synth_note_on(0, 30 + i * 9, 100); }
+    synth_render(out, CONTROL_PERIOD);
+    for(i = 0; i < SYNTH_VOICES; i++) {
+        uint32_t phase = voices.phase[i];
+        CHECK_EQ(voices.increment[i], formula(voices.note[i], detune));
+        CHECK_EQ(voices.increment_step[i], 0);
+        synth_render(out, CONTROL_PERIOD);
+        CHECK_EQ(voices.phase[i] - phase, (uint32_t)(CONTROL_PERIOD * formula(voices.note[i], detune)));
+    }
+
+    return check_done();
+}
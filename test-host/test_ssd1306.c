@@ -0,0 +1,471 @@
+// The SSD1306 refresh state machine, i2c1_ev_isr, dma1_channel6_isr and
+// i2c1_er_isr, against an emulated I2C1 master transmitter and DMA1
+// channel 6. The bus puts one byte on the wire per step and raises the
+// event, DMA and error interrupts the way the F1 does: SB after a start,
+// ADDR after the address until SR2 is read, BTF once the data register
+// and the shift register are empty, and BTF again on the next interrupt
+// until the start or stop is out. A panel model decodes the window
+// commands and the data, after every refresh it has to show screen_data.
+// Built a second time as test_ssd1306_single with SSD1306_DOUBLE_BUFFER 0.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../common/ssd1306_128x32.c"
+
+#include "check.h"
+
+#define PANEL_ADDRESS (0x3C << 1)
+#define MAX_STEPS 100000
+
+static struct SSD1306 display;
+static uint32_t done_calls;
+
+// The emulated peripherals
+static struct {
+    uint32_t sr1, sr2, dr_register;
+    // I2C_CR2 interrupt enables and DMAEN
+    uint32_t cr2;
+    bool dma_requests;
+    bool start_pending, stop_pending;
+    // Between a start and the stop
+    bool open;
+    // A byte waits in DR
+    bool dr_full;
+    uint8_t dr;
+    // Nothing moves after a NACK until the stop
+    bool halted;
+
+    bool channel_enabled;
+    bool tcif;
+    uint32_t memory_address;
+    uint16_t count;
+    const uint8_t *memory;
+
+    // Wire byte of the refresh the panel doesn't acknowledge, -1 for none
+    int32_t nack_at;
+    uint32_t wire_bytes;
+    uint32_t btf_repeats;
+    uint32_t protocol_errors;
+} bus;
+
+// The panel's GDDRAM and its horizontal addressing window
+static uint8_t panel[SSD1306_PAGES][WIDTH];
+static uint8_t col0, col1, page0, page1, col, page;
+
+// Bytes of the transaction on the wire, the address first
+static uint8_t transaction[1 + 1 + WIDTH * SSD1306_PAGES];
+static uint32_t transaction_len;
+// Cut short by a NACK, the panel took the bytes before it
+static bool transaction_nacked;
+static uint32_t transactions;
+static uint32_t data_transactions;
+
+static void done(void) { done_calls++; }
+
+// A stop or repeated start ends the transaction, the panel acts on what it acknowledged
+static void panel_transaction(void) {
+    uint32_t i;
+
+    if(transaction_len == 0 && !transaction_nacked) { return; }
+    transactions++;
+    if(transaction_len > 0) { CHECK_EQ(transaction[0], PANEL_ADDRESS); }
+    if(transaction_len < 2 || (transaction_nacked && transaction[1] == SSD1306_CMD_START && transaction_len < 8)) {
+        transaction_len = 0;
+        transaction_nacked = false;
+        return;
+    }
+
+    if(transaction[1] == SSD1306_CMD_START) {
+        CHECK_EQ(transaction_len, 8);
+        CHECK_EQ(transaction[2], SSD1306_SETCOLRANGE);
+        CHECK_EQ(transaction[5], SSD1306_SETPAGERANGE);
+        col0 = col = transaction[3];
+        col1 = transaction[4];
+        page0 = page = transaction[6];
+        page1 = transaction[7];
+        CHECK(col0 <= col1 && col1 < WIDTH && page0 <= page1 && page1 < SSD1306_PAGES);
+    } else {
+        CHECK_EQ(transaction[1], SSD1306_DATA_START);
+        data_transactions++;
+        for(i = 2; i < transaction_len; i++) {
+            panel[page][col] = transaction[i];
+            if(col++ < col1) { continue; }
+            col = col0;
+            if(page++ == page1) { page = page0; }
+        }
+    }
+    transaction_len = 0;
+    transaction_nacked = false;
+}
+
+static void wire(uint8_t byte) {
+    if(bus.wire_bytes++ == (uint32_t)bus.nack_at) {
+        bus.sr1 |= I2C_SR1_AF;
+        bus.halted = true;
+        transaction_nacked = true;
+        return;
+    }
+    if(transaction_len < sizeof(transaction)) { transaction[transaction_len++] = byte; }
+}
+
+volatile uint32_t *i2c_register(uint32_t address) {
+    switch(address - I2C1) {
+        case 0x10: return &bus.dr_register;
+        case 0x14: return &bus.sr1;
+        case 0x18:
+            // Reading SR2 after SR1 clears ADDR
+            bus.sr1 &= ~I2C_SR1_ADDR;
+            return &bus.sr2;
+        default: abort();
+    }
+}
+
+void i2c_send_start(uint32_t i2c) {
+    (void)i2c;
+    bus.start_pending = true;
+}
+
+void i2c_send_stop(uint32_t i2c) {
+    (void)i2c;
+    bus.stop_pending = true;
+}
+
+void i2c_send_7bit_address(uint32_t i2c, uint8_t slave, uint8_t readwrite) {
+    (void)i2c;
+    if(!(bus.sr1 & I2C_SR1_SB)) { bus.protocol_errors++; }
+    bus.sr1 &= ~I2C_SR1_SB;
+    wire(slave << 1 | readwrite);
+    if(!bus.halted) { bus.sr1 |= I2C_SR1_ADDR; }
+}
+
+void i2c_send_data(uint32_t i2c, uint8_t data) {
+    (void)i2c;
+    // Written before ADDR was cleared, or over a byte still waiting
+    if((bus.sr1 & I2C_SR1_ADDR) || bus.dr_full) { bus.protocol_errors++; }
+    bus.dr = data;
+    bus.dr_full = true;
+    bus.sr1 &= ~I2C_SR1_BTF;
+}
+
+void i2c_enable_interrupt(uint32_t i2c, uint32_t interrupt) {
+    (void)i2c;
+    bus.cr2 |= interrupt;
+}
+
+void i2c_disable_interrupt(uint32_t i2c, uint32_t interrupt) {
+    (void)i2c;
+    bus.cr2 &= ~interrupt;
+}
+
+void i2c_enable_dma(uint32_t i2c) {
+    (void)i2c;
+    bus.dma_requests = true;
+}
+
+void i2c_disable_dma(uint32_t i2c) {
+    (void)i2c;
+    bus.dma_requests = false;
+}
+
+void dma_set_memory_address(uint32_t dma, uint8_t channel, uint32_t address) {
+    (void)dma;
+    (void)channel;
+    // The channel ignores it while enabled
+    if(bus.channel_enabled) { bus.protocol_errors++; }
+    bus.memory_address = address;
+}
+
+void dma_set_number_of_data(uint32_t dma, uint8_t channel, uint16_t number) {
+    (void)dma;
+    (void)channel;
+    if(bus.channel_enabled) { bus.protocol_errors++; }
+    bus.count = number;
+}
+
+// The address is 32 bits on the target, on the host the segment's pointer
+// stands in for it once the low bits match
+void dma_enable_channel(uint32_t dma, uint8_t channel) {
+    const struct SSD1306Segment *seg = &active->queue[active->segment];
+
+    (void)dma;
+    (void)channel;
+    CHECK_EQ(bus.memory_address, (uint32_t)(uintptr_t)seg->data);
+    CHECK_EQ(bus.count, seg->len);
+    bus.memory = seg->data;
+    bus.channel_enabled = true;
+}
+
+void dma_disable_channel(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    (void)channel;
+    bus.channel_enabled = false;
+}
+
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t channel, uint32_t interrupts) {
+    (void)dma;
+    (void)channel;
+    if(interrupts & DMA_TCIF) { bus.tcif = false; }
+}
+
+// Setup only, nothing to emulate
+void i2c_transfer7(uint32_t i2c, uint8_t addr, const uint8_t *w, size_t wn, uint8_t *r, size_t rn) {
+    (void)i2c;
+    (void)addr;
+    (void)w;
+    (void)wn;
+    (void)r;
+    (void)rn;
+}
+void i2c_peripheral_disable(uint32_t i2c) { (void)i2c; }
+void i2c_peripheral_enable(uint32_t i2c) { (void)i2c; }
+void i2c_set_clock_frequency(uint32_t i2c, uint8_t freq) { (void)i2c, (void)freq; }
+void i2c_set_fast_mode(uint32_t i2c) { (void)i2c; }
+void i2c_set_ccr(uint32_t i2c, uint16_t freq) { (void)i2c, (void)freq; }
+void i2c_set_trise(uint32_t i2c, uint16_t trise) { (void)i2c, (void)trise; }
+void dma_channel_reset(uint32_t dma, uint8_t channel) { (void)dma, (void)channel; }
+void dma_set_peripheral_address(uint32_t dma, uint8_t channel, uint32_t address) {
+    (void)dma, (void)channel, (void)address;
+}
+void dma_set_read_from_memory(uint32_t dma, uint8_t channel) { (void)dma, (void)channel; }
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t channel) { (void)dma, (void)channel; }
+void dma_set_peripheral_size(uint32_t dma, uint8_t channel, uint32_t size) { (void)dma, (void)channel, (void)size; }
+void dma_set_memory_size(uint32_t dma, uint8_t channel, uint32_t size) { (void)dma, (void)channel, (void)size; }
+void dma_set_priority(uint32_t dma, uint8_t channel, uint32_t prio) { (void)dma, (void)channel, (void)prio; }
+void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t channel) { (void)dma, (void)channel; }
+void gpio_set_mode(uint32_t gpioport, uint8_t mode, uint8_t cnf, uint16_t gpios) {
+    (void)gpioport, (void)mode, (void)cnf, (void)gpios;
+}
+void rcc_periph_clock_enable(enum rcc_periph_clken clken) { (void)clken; }
+void nvic_enable_irq(uint8_t irqn) { (void)irqn; }
+void nvic_set_priority(uint8_t irqn, uint8_t priority) { (void)irqn, (void)priority; }
+
+// One byte time on the bus, then the pending interrupts. They share a
+// priority, so they run one at a time, DMA1 channel 6 first on its lower
+// IRQ number.
+static void bus_step(void) {
+    if(bus.stop_pending) {
+        bus.stop_pending = false;
+        bus.open = false;
+        bus.halted = false;
+        bus.dr_full = false;
+        bus.sr1 &= ~(I2C_SR1_BTF | I2C_SR1_TxE);
+        panel_transaction();
+    } else if(bus.start_pending) {
+        bus.start_pending = false;
+        // A repeated start ends the transaction before it
+        panel_transaction();
+        bus.open = true;
+        bus.sr1 &= ~(I2C_SR1_BTF | I2C_SR1_TxE);
+        bus.sr1 |= I2C_SR1_SB;
+    } else if(bus.open && !bus.halted && !(bus.sr1 & (I2C_SR1_SB | I2C_SR1_ADDR))) {
+        if(bus.dr_full) {
+            bus.dr_full = false;
+            wire(bus.dr);
+        }
+        // TxE with DMA requests on, the channel refills DR
+        if(!bus.halted && !bus.dr_full && bus.dma_requests && bus.channel_enabled && bus.count > 0) {
+            bus.dr = *bus.memory++;
+            bus.dr_full = true;
+            if(--bus.count == 0) { bus.tcif = true; }
+        }
+        if(!bus.halted && !bus.dr_full) { bus.sr1 |= I2C_SR1_BTF | I2C_SR1_TxE; }
+    }
+
+    if(bus.tcif) { dma1_channel6_isr(); }
+    if((bus.cr2 & I2C_CR2_ITERREN) && (bus.sr1 & (I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR))) {
+        i2c1_er_isr();
+    } else if((bus.cr2 & I2C_CR2_ITEVTEN) && (bus.sr1 & (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_BTF))) {
+        i2c1_ev_isr();
+        // BTF is still set until the start or stop is out, the interrupt comes straight back
+        if((bus.cr2 & I2C_CR2_ITEVTEN) && (bus.sr1 & I2C_SR1_BTF)) {
+            bus.btf_repeats++;
+            i2c1_ev_isr();
+        }
+    }
+}
+
+// Refresh and run the bus until it is idle again
+static void refresh(void) {
+    uint32_t steps = 0;
+
+    bus.wire_bytes = 0;
+    transactions = 0;
+    data_transactions = 0;
+    CHECK(SSD1306_refresh(&display));
+    while((display.busy || bus.start_pending || bus.stop_pending) && steps++ < MAX_STEPS) { bus_step(); }
+
+    CHECK(!display.busy);
+    CHECK(!bus.open);
+    CHECK(!bus.channel_enabled);
+    CHECK(!bus.dma_requests);
+    CHECK(!bus.tcif);
+    CHECK_EQ(bus.cr2, 0);
+    CHECK_EQ(bus.protocol_errors, 0);
+}
+
+static bool panel_shows_screen(void) { return memcmp(panel, display.screen_data, sizeof(panel)) == 0; }
+
+static void setup(void) {
+    memset(&bus, 0, sizeof(bus));
+    bus.nack_at = -1;
+    // Whatever the panel powered up with
+    memset(panel, 0xA5, sizeof(panel));
+    memset(&display, 0, sizeof(display));
+    SSD1306_init(&display, I2C1);
+    SSD1306_set_done_callback(&display, done);
+    done_calls = 0;
+}
+
+static void test_full_refresh(void) {
+    setup();
+    SSD1306_draw_string(&display, 0, 0, "ADC1:1234");
+    SSD1306_draw_string(&display, 3, 13, "MIDI:-567");
+    refresh();
+    CHECK(panel_shows_screen());
+    // The window and one 512 byte stream
+    CHECK_EQ(transactions, 2);
+    CHECK_EQ(display.bytes_sent, SSD1306_RECT_OVERHEAD + WIDTH * SSD1306_PAGES);
+    CHECK_EQ(display.bytes_sent, bus.wire_bytes - transactions);
+    CHECK_EQ(done_calls, 1);
+    // The end of the window segment saw BTF twice and acted once, the
+    // last one stops and disables the event interrupt straight away
+    CHECK_EQ(bus.btf_repeats, 1);
+}
+
+// Without changes the double buffer sends nothing, the single one the whole frame
+static void test_no_change(void) {
+    setup();
+    SSD1306_draw_string(&display, 0, 8, "same");
+    refresh();
+    refresh();
+    CHECK(panel_shows_screen());
+#if SSD1306_DOUBLE_BUFFER
+    CHECK_EQ(transactions, 0);
+    CHECK_EQ(display.bytes_sent, 0);
+    CHECK_EQ(done_calls, 1);
+#else
+    CHECK_EQ(transactions, 2);
+    CHECK_EQ(done_calls, 2);
+#endif
+}
+
+static void test_spans(void) {
+    setup();
+    refresh();
+
+    // One pixel on page 1 and 8 columns on page 3, separate spans beat a burst over three pages
+    SSD1306_draw_pixel(&display, 10, 12);
+    memset(display.screen_data + 3 * WIDTH + 100, 0xFF, 8);
+    refresh();
+    CHECK(panel_shows_screen());
+    CHECK_EQ(display.bytes_sent, bus.wire_bytes - transactions);
+#if SSD1306_DOUBLE_BUFFER
+    CHECK_EQ(data_transactions, 2);
+    CHECK_EQ(transactions, 4);
+    CHECK_EQ(display.bytes_sent, (SSD1306_RECT_OVERHEAD + 1) + (SSD1306_RECT_OVERHEAD + 8));
+#else
+    CHECK_EQ(transactions, 2);
+#endif
+}
+
+static void test_burst(void) {
+    setup();
+    refresh();
+
+    // Two nearly full pages: 2 x (8 + 127) bytes as spans, 8 + 256 as one burst
+    memset(display.screen_data + WIDTH + 1, 0x3C, WIDTH * 2 - 2);
+    refresh();
+    CHECK(panel_shows_screen());
+    CHECK_EQ(transactions, 2);
+#if SSD1306_DOUBLE_BUFFER
+    CHECK_EQ(display.bytes_sent, SSD1306_RECT_OVERHEAD + WIDTH * 2);
+#endif
+    CHECK_EQ(display.bytes_sent, bus.wire_bytes - transactions);
+
+    // Both ends of two pages apart, the burst would carry a whole page between them
+    display.screen_data[0] ^= 1;
+    display.screen_data[WIDTH * 2 + 5] ^= 1;
+    refresh();
+    CHECK(panel_shows_screen());
+#if SSD1306_DOUBLE_BUFFER
+    CHECK_EQ(data_transactions, 2);
+    CHECK_EQ(display.bytes_sent, (SSD1306_RECT_OVERHEAD + 1) * 2);
+#endif
+}
+
+static void test_busy(void) {
+    setup();
+    SSD1306_draw_string(&display, 0, 0, "busy");
+    CHECK(SSD1306_refresh(&display));
+    CHECK(SSD1306_busy(&display));
+    // The second call leaves the transfer in flight alone
+    CHECK(!SSD1306_refresh(&display));
+    while(display.busy || bus.start_pending || bus.stop_pending) { bus_step(); }
+    CHECK(panel_shows_screen());
+    CHECK_EQ(done_calls, 1);
+}
+
+// A NACK drops the frame, the next refresh has to put the whole panel right
+static void test_nack(int32_t at) {
+    setup();
+    refresh();
+    SSD1306_draw_string(&display, 8, 4, "NACK");
+    SSD1306_draw_char(&display, 120, 26, '#');
+
+    bus.nack_at = at;
+    refresh();
+    CHECK_EQ(display.errors, 1);
+    CHECK_EQ(done_calls, 2);
+    CHECK(!panel_shows_screen());
+
+    bus.nack_at = -1;
+    refresh();
+    CHECK(panel_shows_screen());
+    CHECK_EQ(display.errors, 1);
+    // Everything goes again, the double buffer doesn't trust its shadow any more
+    CHECK_EQ(transactions, 2);
+    CHECK_EQ(display.bytes_sent, SSD1306_RECT_OVERHEAD + WIDTH * SSD1306_PAGES);
+}
+
+// Random drawing with a NACK now and then, the panel is right after every clean refresh
+static void test_random(void) {
+    uint32_t i, j, errors = 0, sent = 0;
+
+    setup();
+    srand(2);
+    for(i = 0; i < 500; i++) {
+        for(j = rand() % 4; j > 0; j--) {
+            SSD1306_draw_char(&display, rand() % WIDTH, rand() % HEIGHT, 32 + rand() % 96);
+        }
+        if(rand() % 8 == 0) { SSD1306_clear(&display, 0); }
+        if(rand() % 16 == 0) { SSD1306_invalidate(&display); }
+        bus.nack_at = rand() % 10 == 0 ? rand() % 600 : -1;
+        refresh();
+        if(transactions > 0) { sent++; }
+        if(display.errors != errors) {
+            errors = display.errors;
+            continue;
+        }
+        CHECK(panel_shows_screen());
+    }
+    CHECK(errors > 0);
+    // Once per refresh that went out, dropped ones included
+    CHECK_EQ(done_calls, sent);
+}
+
+int main(void) {
+    test_full_refresh();
+    test_no_change();
+    test_spans();
+    test_burst();
+    test_busy();
+    // On the address, the window commands, the first data byte and mid-stream
+    test_nack(0);
+    test_nack(4);
+    test_nack(10);
+    test_nack(14);
+    test_random();
+
+    return check_done();
+}
@@ -0,0 +1,4 @@
+// test_ssd1306 without the shadow buffer, every refresh streams the whole frame
+#define SSD1306_DOUBLE_BUFFER 0
+
+#include "test_ssd1306.c"
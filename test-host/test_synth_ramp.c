@@ -0,0 +1,117 @@
+// Gain ramps around events that land mid-block: released voices have to
+// reach silence and stop rendering, and extra events must not move a
+// voice's envelope faster. Includes synth.c for the voice state.
+
+#include <stdlib.h>
+
+#include "../common/synth.c"
+
+#include "check.h"
+
+// Frames the fake DAC has sent, events are stamped with it
+static uint32_t now;
+
+static uint32_t fake_clock(void) { return now; }
+
+// Queue a channel message due at the given frame
+static void queue_at(uint32_t frame, uint8_t status, uint8_t data1, uint8_t data2) {
+    MidiEvent event = {status >> 4, status, data1, data2, 0, 0};
+
+    now = frame;
+    synth_queue_event(&event);
+}
+
+static void render_blocks(int blocks) {
+    uint16_t out[CONTROL_PERIOD * 2];
+
+    while(blocks--) { synth_render(out, CONTROL_PERIOD); }
+}
+
+static int find_voice(uint8_t note) {
+    int i;
+
+    for(i = 0; i < SYNTH_VOICES; i++) {
+        if(voices.stage[i] != ENV_IDLE && voices.note[i] == note - 69) { return i; }
+    }
+    return -1;
+}
+
+// Note-offs at random frames inside the blocks, then every voice has to go fully idle
+static void test_release_to_silence(void) {
+    int round, i;
+
+    srand(1);
+    for(round = 0; round < 50; round++) {
+        for(i = 0; i < SYNTH_VOICES; i++) { queue_at(render_frame + rand() % 200, MIDI_NOTE_ON, 40 + i * 5, 1 + rand() % 127); }
+        render_blocks(10);
+        for(i = 0; i < SYNTH_VOICES; i++) { queue_at(render_frame + rand() % 200, MIDI_NOTE_OFF, 40 + i * 5, 0); }
+        render_blocks(10000);
+
+        for(i = 0; i < SYNTH_VOICES; i++) {
+            CHECK_EQ(voices.stage[i], ENV_IDLE);
+            CHECK_EQ(voices.gain[i], 0);
+            CHECK_EQ(voices.gain_step[i], 0);
+        }
+    }
+}
+
+// Two notes started together, one retriggered in the middle of every control
+// period: their envelopes have to stay in step, through attack and release
+static void test_dense_events(void) {
+    int a, b, period;
+
+    // Slow attack and release, applied at the next control tick
+    synth_control_change(0, ENV_CC_ATTACK, 90);
+    synth_control_change(0, ENV_CC_RELEASE, 90);
+    render_blocks(1);
+
+    queue_at(render_frame, MIDI_NOTE_ON, 60, 100);
+    queue_at(render_frame, MIDI_NOTE_ON, 72, 100);
+    render_blocks(1);
+    a = find_voice(60);
+    b = find_voice(72);
+    CHECK(a >= 0 && b >= 0);
+    if(a < 0 || b < 0) { return; }
+
+    for(period = 0; period < 200; period++) {
+        if(period == 100) {
+            queue_at(render_frame + 5, MIDI_NOTE_OFF, 60, 0);
+            queue_at(render_frame + 5, MIDI_NOTE_OFF, 72, 0);
+        } else if(period < 100) {
+            queue_at(render_frame + 11, MIDI_NOTE_ON, 72, 100);
+            queue_at(render_frame + 23, MIDI_NOTE_ON, 72, 100);
+        }
+        render_blocks(1);
+        CHECK_EQ(voices.level[b], voices.level[a]);
+        CHECK_EQ(voices.stage[b], voices.stage[a]);
+    }
+    CHECK(voices.level[a] > 0);
+}
+
+// A note-on mid-period still starts at its own frame, not at the next tick
+static void test_onset_frame(void) {
+    uint16_t out[CONTROL_PERIOD * 2];
+    int v;
+
+    render_blocks(20000);
+    queue_at(render_frame + 13, MIDI_NOTE_ON, 64, 127);
+    synth_render(out, 13);
+    CHECK(find_voice(64) < 0);
+    synth_render(out, 2);
+    v = find_voice(64);
+    CHECK(v >= 0);
+    if(v < 0) { return; }
+    CHECK(voices.gain[v] > 0);
+    CHECK(control_countdown > 0 && control_countdown < CONTROL_PERIOD);
+}
+
+int main(void) {
+    synth_init();
+    synth_set_clock(fake_clock, 0);
+
+    test_release_to_silence();
+    test_dense_events();
+    test_onset_frame();
+
+    return check_done();
+}
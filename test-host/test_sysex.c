@@ -0,0 +1,221 @@
+// SysEx receiver: messages reassembled from USB-MIDI packets of every
+// ending length, handler matching by prefix, messages that don't fit, and
+// packets that arrive without a start or from another cable mid-message.
+
+#include <string.h>
+
+#include "check.h"
+#include "sysex.h"
+
+static uint8_t received[64];
+static uint32_t received_len;
+static uint32_t calls[3];
+
+static void handler_a(const uint8_t *message, uint32_t len) {
+    memcpy(received, message, len);
+    received_len = len;
+    calls[0]++;
+}
+
+static void handler_b(const uint8_t *message, uint32_t len) {
+    (void)message;
+    (void)len;
+    calls[1]++;
+}
+
+static void handler_c(const uint8_t *message, uint32_t len) {
+    (void)message;
+    (void)len;
+    calls[2]++;
+}
+
+static void reset(void) {
+    memset(received, 0, sizeof(received));
+    received_len = 0;
+    memset(calls, 0, sizeof(calls));
+}
+
+// Send message[0..len) as USB-MIDI SysEx packets on the given cable, like a
+// host does: CIN 0x4 for three bytes, the last packet CIN 0x5 to 0x7.
+// Without the 0xF7 len has to be a multiple of three, the message is cut off there.
+static void send(SysexReceiver *rx, const uint8_t *message, uint32_t len, uint8_t cable) {
+    uint32_t i = 0, n;
+
+    while(i < len) {
+        MidiEvent event = {0, 0, 0, 0, 0, 0};
+        uint8_t bytes[3] = {0, 0, 0};
+
+        n = len - i > 3 ? 3 : len - i;
+        memcpy(bytes, &message[i], n);
+        i += n;
+        event.header = cable << 4 | (bytes[n - 1] == 0xF7 ? 0x4 + n : 0x4);
+        event.status = bytes[0];
+        event.data1 = bytes[1];
+        event.data2 = bytes[2];
+        CHECK(sysex_receive(rx, &event));
+    }
+}
+
+static void setup(SysexReceiver *rx, uint8_t *buffer, uint32_t size) {
+    static const uint8_t prefix_a[] = {0x7D, 0x01};
+    static const uint8_t prefix_b[] = {0x7D};
+    static const uint8_t prefix_c[] = {0x7E, 0x7F, 0x06, 0x01};
+
+    reset();
+    sysex_init(rx, buffer, size);
+    // The first registered match wins, so the longer 7D 01 goes first
+    CHECK(sysex_register(rx, prefix_a, sizeof(prefix_a), handler_a));
+    CHECK(sysex_register(rx, prefix_b, sizeof(prefix_b), handler_b));
+    CHECK(sysex_register(rx, prefix_c, sizeof(prefix_c), handler_c));
+}
+
+static void test_reassembly(void) {
+    uint8_t buffer[64], message[40];
+    SysexReceiver rx;
+    uint32_t len, i;
+
+    setup(&rx, buffer, sizeof(buffer));
+
+    // Every ending packet length, CIN 0x5, 0x6 and 0x7
+    for(len = 4; len <= sizeof(message); len++) {
+        message[0] = 0xF0;
+        message[1] = 0x7D;
+        message[2] = 0x01;
+        for(i = 3; i < len - 1; i++) { message[i] = (i * 7 + len) & 0x7F; }
+        message[len - 1] = 0xF7;
+
+        received_len = 0;
+        send(&rx, message, len, 0);
+        CHECK_EQ(received_len, len);
+        CHECK(memcmp(received, message, len) == 0);
+    }
+    CHECK_EQ(calls[0], sizeof(message) - 3);
+    CHECK_EQ(rx.messages, sizeof(message) - 3);
+    CHECK_EQ(rx.overflows + rx.dropped + rx.unhandled, 0);
+}
+
+static void test_matching(void) {
+    static const uint8_t patch[] = {0xF0, 0x7D, 0x01, 0x00, 0xF7};
+    static const uint8_t stats[] = {0xF0, 0x7D, 0x02, 0xF7};
+    static const uint8_t identity[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+    // Other device ID, and a request cut short before the prefix is complete
+    static const uint8_t other_device[] = {0xF0, 0x7E, 0x10, 0x06, 0x01, 0xF7};
+    static const uint8_t short_identity[] = {0xF0, 0x7E, 0x7F, 0x06, 0xF7};
+    static const uint8_t empty[] = {0xF0, 0xF7};
+    static const uint8_t prefix[] = {0x01};
+    uint8_t buffer[64];
+    SysexReceiver rx;
+
+    setup(&rx, buffer, sizeof(buffer));
+    send(&rx, patch, sizeof(patch), 0);
+    send(&rx, stats, sizeof(stats), 0);
+    send(&rx, identity, sizeof(identity), 3);
+    CHECK_EQ(calls[0], 1);
+    CHECK_EQ(calls[1], 1);
+    CHECK_EQ(calls[2], 1);
+
+    send(&rx, other_device, sizeof(other_device), 0);
+    send(&rx, short_identity, sizeof(short_identity), 0);
+    send(&rx, empty, sizeof(empty), 0);
+    CHECK_EQ(calls[2], 1);
+    CHECK_EQ(rx.unhandled, 3);
+    CHECK_EQ(rx.messages, 6);
+
+    // The slots are full, and a prefix can't be longer than SYSEX_PREFIX
+    CHECK(sysex_register(&rx, prefix, 1, handler_a));
+    CHECK(!sysex_register(&rx, prefix, 1, handler_a));
+    sysex_init(&rx, buffer, sizeof(buffer));
+    CHECK(!sysex_register(&rx, prefix, SYSEX_PREFIX + 1, handler_a));
+}
+
+static void test_overflow(void) {
+    static const uint8_t fits[] = {0xF0, 0x7D, 0x01, 0x10, 0x20, 0x30, 0x40, 0xF7};
+    uint8_t buffer[16 + 1], message[20];
+    SysexReceiver rx;
+    uint32_t i;
+
+    message[0] = 0xF0;
+    message[1] = 0x7D;
+    message[2] = 0x01;
+    for(i = 3; i < sizeof(message) - 1; i++) { message[i] = i; }
+    message[sizeof(message) - 1] = 0xF7;
+
+    // The buffer is one longer than it says, nothing may go past the size
+    setup(&rx, buffer, sizeof(buffer) - 1);
+    buffer[16] = 0xAA;
+    send(&rx, message, sizeof(message), 0);
+    CHECK_EQ(buffer[16], 0xAA);
+    CHECK_EQ(calls[0], 0);
+    CHECK_EQ(rx.overflows, 1);
+    CHECK_EQ(rx.messages, 0);
+
+    // Exactly the buffer size fits
+    message[15] = 0xF7;
+    send(&rx, message, 16, 0);
+    CHECK_EQ(calls[0], 1);
+    CHECK_EQ(received_len, 16);
+    message[15] = 15;
+
+    // The next message is taken whole again
+    send(&rx, fits, sizeof(fits), 0);
+    CHECK_EQ(calls[0], 2);
+    CHECK_EQ(received_len, sizeof(fits));
+    CHECK(memcmp(received, fits, sizeof(fits)) == 0);
+    CHECK_EQ(rx.overflows, 1);
+}
+
+static void test_dropped(void) {
+    static const uint8_t patch[] = {0xF0, 0x7D, 0x01, 0x10, 0x20, 0x30, 0x40, 0xF7};
+    uint8_t buffer[64];
+    SysexReceiver rx;
+
+    setup(&rx, buffer, sizeof(buffer));
+
+    // The middle and end of a message whose start was lost
+    send(&rx, &patch[3], sizeof(patch) - 3, 0);
+    CHECK_EQ(rx.dropped, 2);
+    CHECK_EQ(rx.messages, 0);
+
+    // Another cable can't cut into a message, its packets are dropped
+    send(&rx, patch, 3, 0);
+    send(&rx, &patch[3], 3, 1);
+    send(&rx, &patch[3], sizeof(patch) - 3, 0);
+    CHECK_EQ(rx.dropped, 3);
+    CHECK_EQ(calls[0], 1);
+    CHECK(memcmp(received, patch, sizeof(patch)) == 0);
+
+    // A start without an end is abandoned by the next start
+    send(&rx, patch, 6, 0);
+    send(&rx, patch, sizeof(patch), 0);
+    CHECK_EQ(calls[0], 2);
+    CHECK_EQ(received_len, sizeof(patch));
+    CHECK_EQ(rx.messages, 2);
+}
+
+static void test_other_events(void) {
+    static const MidiEvent others[] = {
+        {0x09, 0x90, 60, 100, 0, 0},
+        {0x0B, 0xB0, 1, 64, 0, 0},
+        {0x0F, 0xF8, 0, 0, 0, 0},
+        // CIN 0x5 is also a single byte system common message
+        {0x05, 0xF6, 0, 0, 0, 0},
+        {0x02, 0xF3, 1, 0, 0, 0},
+    };
+    uint8_t buffer[64];
+    SysexReceiver rx;
+    uint32_t i;
+
+    setup(&rx, buffer, sizeof(buffer));
+    for(i = 0; i < sizeof(others) / sizeof(others[0]); i++) { CHECK(!sysex_receive(&rx, &others[i])); }
+    CHECK_EQ(rx.messages + rx.dropped, 0);
+}
+
+int main(void) {
+    test_reassembly();
+    test_matching();
+    test_overflow();
+    test_dropped();
+    test_other_events();
+
+    return check_done();
+}
@@ -0,0 +1,65 @@
+// Boot time voice calibration against a fake cycle counter whose render
+// cost is a fixed part plus a part per sounding voice, per frame. The
+// limit has to come out of that cost model, the allocator must keep to it
+// and the synth has to be left silent at the frame it started from.
+
+#include "../common/synth.c"
+
+#include "check.h"
+
+#define BASE_CYCLES 100
+#define VOICE_CYCLES 50
+
+static uint32_t fake_counter(void) { return render_frame * (BASE_CYCLES + VOICE_CYCLES * synth_active_voices()); }
+
+// Budget per control period for this many voices and half of another
+static uint32_t budget_for(uint32_t voices) {
+    return CONTROL_PERIOD * (BASE_CYCLES + voices * VOICE_CYCLES + VOICE_CYCLES / 2);
+}
+
+static void test_limit(void) {
+    static uint16_t out[CONTROL_PERIOD * 2];
+    const uint8_t expected = SYNTH_VOICES * 5 / 8;
+    uint32_t frame;
+    SynthStats stats;
+    int i;
+
+    synth_init();
+    frame = render_frame;
+    CHECK_EQ(synth_calibrate_voices(fake_counter, budget_for(expected)), expected);
+
+    synth_get_stats(&stats);
+    CHECK_EQ(stats.voice_limit, expected);
+    CHECK_EQ(stats.voice_cycles, CONTROL_PERIOD * VOICE_CYCLES);
+
+    // Silent, and back at the frame it started from
+    CHECK_EQ(render_frame, frame);
+    CHECK_EQ(synth_active_voices(), 0);
+    synth_render(out, CONTROL_PERIOD);
+    for(i = 0; i < SYNTH_VOICES; i++) { CHECK_EQ(voices.gain[i], 0); }
+    for(i = 1; i < CONTROL_PERIOD * 2; i++) { CHECK_EQ(out[i], out[0]); }
+
+    // More notes than the limit, the extra ones steal
+    for(i = 0; i < SYNTH_VOICES; i++) { synth_note_on(0, 40 + i, 100); }
+    CHECK_EQ(synth_active_voices(), expected);
+    for(i = 0; i < 100; i++) { synth_render(out, CONTROL_PERIOD); }
+    for(i = expected; i < SYNTH_VOICES; i++) { CHECK_EQ(voices.gain[i], 0); }
+}
+
+static void test_bounds(void) {
+    synth_init();
+    // Not even the silent render fits, one voice is still better than none
+    CHECK_EQ(synth_calibrate_voices(fake_counter, BASE_CYCLES), 1);
+    CHECK_EQ(synth_calibrate_voices(fake_counter, budget_for(1)), 1);
+    CHECK_EQ(synth_calibrate_voices(fake_counter, UINT32_MAX), SYNTH_VOICES);
+    // Calibrating again starts over from the whole pool
+    CHECK_EQ(synth_calibrate_voices(fake_counter, budget_for(3)), 3);
+    CHECK_EQ(synth_calibrate_voices(fake_counter, budget_for(SYNTH_VOICES)), SYNTH_VOICES);
+}
+
+int main(void) {
+    test_limit();
+    test_bounds();
+
+    return check_done();
+}